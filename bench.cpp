@@ -0,0 +1,451 @@
+// bench.cpp
+//
+// Throughput and latency of `HashTable` against `std::unordered_map`, and
+// abseil's `flat_hash_map` when built with `-DWITH_ABSL`:
+//
+//   g++ -std=c++17 -O2 -march=native -pthread bench.cpp -o bench
+//   g++ -std=c++17 -O2 -march=native -pthread -DWITH_ABSL bench.cpp -o bench
+//       -labsl_hash -labsl_city -labsl_low_level_hash -labsl_raw_hash_set
+//   ./bench --sizes=1000,1000000 --keylens=8,40,120 --loads=0.5,0.7 --hit=0.9
+//   ./bench --dist=zipf:0.99
+//   python main.py --dump-keys keys.txt && ./bench --trace=keys.txt
+//
+// Each row times one operation over a table of `size` entries with keys of
+// `keylen` bytes, and shows the table's real `size / capacity` as `load`.
+// `HashTable` is sized for each of `--loads` and filled with as many keys as
+// reach it once its capacity is rounded, so `size` may be below `--sizes`;
+// loads above its collision policy's maximum are skipped. The other tables
+// just `reserve(size)`. Latency percentiles are per-op averages over windows
+// of `window` consecutive ops, since a clock read per op would cost more
+// than the op itself.
+//
+// `--dist` picks which keys the lookups hit (see `KeyDistribution`); the
+// default is uniform. `--trace` replays the keys the Python driver inserted,
+// in its order, instead of the synthetic tables. `small-map` rows close the
+// run, timing whole lifetimes of 8-entry maps.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "hash_table.hpp"
+#include "workload.hpp"
+
+#ifdef WITH_ABSL
+#include <absl/container/flat_hash_map.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t window = 64;
+
+struct Config {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+    std::vector<size_t> keylens = {8, 40, 120};
+    std::vector<double> loads = {0.7};
+    double hit = 0.9;  // Share of `mixed` lookups that find their key
+    size_t min_ops = 200000;
+    KeyDistribution dist;
+    std::string trace;
+};
+
+// Keys for one size and key length, and the order ops visit them in
+struct Workload {
+    std::vector<std::string_view> keys;
+    std::vector<std::string_view> misses;  // Like `keys`, never inserted
+    std::vector<uint32_t> order;    // Each key once, shuffled, for `remove`
+    std::vector<uint32_t> lookups;  // Drawn from `Config::dist`, one per op
+    std::vector<bool> hits;         // Whether each `mixed` lookup should find
+};
+
+// The first `n` of `keys` and `misses`, with ops over them drawn as
+// `cfg` says
+Workload make_workload(const std::vector<std::string> &keys,
+                       const std::vector<std::string> &misses, size_t n,
+                       const Config &cfg) {
+    Workload w;
+    w.keys.assign(keys.begin(), keys.begin() + n);
+    w.misses.assign(misses.begin(), misses.begin() + n);
+    w.order.resize(n);
+    std::iota(w.order.begin(), w.order.end(), 0);
+    std::shuffle(w.order.begin(), w.order.end(), std::mt19937(3));
+    const size_t ops = std::max(cfg.min_ops, n);
+    w.lookups = cfg.dist.sample(n, ops, 4);
+    std::mt19937_64 coin(5);
+    w.hits.resize(ops);
+    for (size_t i = 0; i < ops; i++)
+        w.hits[i] =
+            std::uniform_real_distribution<double>(0, 1)(coin) < cfg.hit;
+    return w;
+}
+
+struct Result {
+    double mops;
+    double p50_ns;
+    double p99_ns;
+};
+
+// Run `op(i)` for `n` ops, timing windows of `window` ops
+template <typename Op>
+Result measure(size_t n, Op &&op) {
+    std::vector<double> samples;
+    samples.reserve(n / window + 1);
+    const auto start = Clock::now();
+    auto last = start;
+    for (size_t i = 0; i < n; i++) {
+        op(i);
+        if ((i + 1) % window == 0) {
+            const auto now = Clock::now();
+            samples.push_back(
+                std::chrono::duration<double, std::nano>(now - last).count() /
+                window);
+            last = now;
+        }
+    }
+    const double total =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    Result r{n / total / 1e6, 0, 0};
+    if (!samples.empty()) {
+        std::sort(samples.begin(), samples.end());
+        r.p50_ns = samples[samples.size() / 2];
+        r.p99_ns = samples[samples.size() * 99 / 100];
+    }
+    return r;
+}
+
+void print_row(const char *table, size_t size, double load, size_t keylen,
+               const char *op, const Result &r) {
+    std::printf("%-24s %10zu %5.2f %6zu  %-12s %8.2f %8.1f %8.1f\n", table,
+                size, load, keylen, op, r.mops, r.p50_ns, r.p99_ns);
+}
+
+std::vector<std::string> make_keys(size_t n, size_t len, uint64_t seed) {
+    static constexpr char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> keys(n, std::string(len, ' '));
+    for (auto &key : keys)
+        for (auto &c : key) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    return keys;
+}
+
+// Uniform adapters over the tables under test, built for `entries` keys in
+// `capacity` slots (tables that size themselves take just `entries`)
+
+template <typename Table>
+struct OursAdapter {
+    Table table;
+    OursAdapter(size_t capacity, size_t) : table(capacity) {}
+
+    // Capacity to build with and entries that fill it to `load`: `n / load`
+    // as `Table` rounds it, halved while rounding up leaves more slots than
+    // `n` keys can fill, as `hash_quality` does
+    static std::pair<size_t, size_t> shape(size_t n, double load) {
+        size_t cap = Table(static_cast<size_t>(n / load) + 1).capacity();
+        while (static_cast<size_t>(load * cap) > n) {
+            const size_t half = Table(cap / 2).capacity();
+            if (half == cap) break;  // Already the minimum
+            cap = half;
+        }
+        return {cap, std::min(n, static_cast<size_t>(load * cap))};
+    }
+    static double max_load(void) { return Table::load_capacity_threshold; }
+
+    void insert(std::string_view k, int v) { table.insert(k, v); }
+    bool get(std::string_view k) { return table.get(k).has_value(); }
+    void remove(std::string_view k) { table.remove(k); }
+    // Finish any resize, so lookups are timed on one settled table
+    void settle(void) {
+        while (table.is_rehashing()) table.get(std::string_view());
+    }
+    double load(void) const {
+        return static_cast<double>(table.size()) / table.capacity();
+    }
+};
+
+template <typename Map>
+struct StdAdapter {
+    Map table;
+    StdAdapter(size_t, size_t entries) { table.reserve(entries); }
+
+    static std::pair<size_t, size_t> shape(size_t n, double) { return {n, n}; }
+    static double max_load(void) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    void insert(std::string_view k, int v) { table.insert_or_assign(k, v); }
+    bool get(std::string_view k) { return table.find(k) != table.end(); }
+    void remove(std::string_view k) { table.erase(k); }
+    void settle(void) {}
+    double load(void) const { return table.load_factor(); }
+};
+
+// Note a `load` row set skipped for exceeding `Adapter::max_load`
+template <typename Adapter>
+bool skip_load(const char *name, size_t size, double load, size_t keylen) {
+    if (load <= Adapter::max_load()) return false;
+    std::printf("%-24s %10zu %5.2f %6zu  skipped, above max load %.2f\n", name,
+                size, load, keylen, Adapter::max_load());
+    return true;
+}
+
+template <typename Adapter>
+void bench_table(const char *name, size_t size, double load, size_t keylen,
+                 const std::vector<std::string> &keys,
+                 const std::vector<std::string> &misses, const Config &cfg) {
+    if (skip_load<Adapter>(name, size, load, keylen)) return;
+    const auto [capacity, n] = Adapter::shape(size, load);
+    const Workload w = make_workload(keys, misses, n, cfg);
+    const auto &lookups = w.lookups;
+    Adapter ht(capacity, n);
+    const Result inserted = measure(n, [&](size_t i) {
+        ht.insert(w.keys[i], static_cast<int>(i));
+    });
+    ht.settle();
+    const double real = ht.load();
+    print_row(name, n, real, keylen, "insert", inserted);
+
+    const size_t ops = lookups.size();
+    size_t found = 0;
+    print_row(name, n, real, keylen, "get", measure(ops, [&](size_t i) {
+                  found += ht.get(w.keys[lookups[i]]);
+              }));
+    print_row(name, n, real, keylen, "miss", measure(ops, [&](size_t i) {
+                  found += ht.get(w.misses[lookups[i]]);
+              }));
+    print_row(name, n, real, keylen, "mixed", measure(ops, [&](size_t i) {
+                  const uint32_t j = lookups[i];
+                  found += ht.get(w.hits[i] ? w.keys[j] : w.misses[j]);
+              }));
+    print_row(name, n, real, keylen, "remove", measure(n, [&](size_t i) {
+                  ht.remove(w.keys[w.order[i]]);
+              }));
+    if (found == 0) std::printf("(no hits)\n");  // Keeps the lookups alive
+}
+
+// `get` one key at a time against `get_batch` on the same table and keys
+template <typename Table>
+void bench_batch(const char *name, size_t size, double load, size_t keylen,
+                 const std::vector<std::string> &keys,
+                 const std::vector<std::string> &misses, const Config &cfg) {
+    using Adapter = OursAdapter<Table>;
+    if (skip_load<Adapter>(name, size, load, keylen)) return;
+    const auto [capacity, n] = Adapter::shape(size, load);
+    const Workload w = make_workload(keys, misses, n, cfg);
+    Adapter adapter(capacity, n);
+    for (size_t i = 0; i < n; i++)
+        adapter.insert(w.keys[i], static_cast<int>(i));
+    adapter.settle();
+    const double real = adapter.load();
+    Table &ht = adapter.table;
+
+    const size_t ops = w.lookups.size() / window * window;
+    std::vector<std::string_view> queries(ops);
+    for (size_t i = 0; i < ops; i++) queries[i] = w.keys[w.lookups[i]];
+    std::vector<std::optional<int>> out(window);
+
+    const Result scalar = measure(ops, [&](size_t i) {
+        out[i % window] = ht.get(queries[i]);
+    });
+    // One `get_batch` call per window, attributed to its last op
+    const Result batch = measure(ops, [&](size_t i) {
+        if ((i + 1) % window == 0)
+            ht.get_batch(&queries[i + 1 - window], window, out.data());
+    });
+    print_row(name, n, real, keylen, "get", scalar);
+    print_row(name, n, real, keylen, "get_batch", batch);
+    std::printf("%-24s %10zu %5.2f %6zu  batch speedup %.2fx\n", name, n,
+                real, keylen, batch.mops / scalar.mops);
+}
+
+// Loading `size` pairs by `insert` in a loop against the bulk constructor
+template <typename Table>
+void bench_build(const char *name, size_t size, size_t keylen,
+                 const std::vector<std::string> &keys) {
+    std::vector<std::pair<std::string_view, int>> pairs(size);
+    for (size_t i = 0; i < size; i++)
+        pairs[i] = {keys[i], static_cast<int>(i)};
+    const auto timed = [&](auto &&build) {
+        const auto start = Clock::now();
+        build();
+        const double secs =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        return Result{size / secs / 1e6, 0, 0};
+    };
+    size_t built = 0;
+    double load = 0;  // Of the table last built
+    const Result looped = timed([&] {
+        Table ht(16);
+        for (const auto &[k, v] : pairs) ht.insert(k, v);
+        built += ht.size();
+        load = static_cast<double>(ht.size()) / ht.capacity();
+    });
+    print_row(name, size, load, keylen, "insert-loop", looped);
+    const Result bulk = timed([&] {
+        Table ht(pairs.begin(), pairs.end());
+        built += ht.size();
+        load = static_cast<double>(ht.size()) / ht.capacity();
+    });
+    print_row(name, size, load, keylen, "bulk-build", bulk);
+    if (built != 2 * size) std::printf("(build lost entries)\n");
+}
+
+// Replay a `main.py --dump-keys` trace: insert (or update) every key in
+// trace order, then look each up again in the same order
+template <typename Adapter>
+void bench_trace(const char *name, const std::vector<std::string_view> &trace) {
+    const size_t n = trace.size();
+    Adapter ht(static_cast<size_t>(n / 0.7) + 1, n);
+    size_t found = 0;
+    const Result inserted = measure(n, [&](size_t i) {
+        ht.insert(trace[i], static_cast<int>(i));
+    });
+    ht.settle();
+    print_row(name, n, ht.load(), 0, "trace-insert", inserted);
+    print_row(name, n, ht.load(), 0, "trace-get", measure(n, [&](size_t i) {
+                  found += ht.get(trace[i]);
+              }));
+    if (found == 0) std::printf("(no hits)\n");
+}
+
+// A tiny per-request map's whole life per op: build one holding `keys`,
+// look each up, drop it
+template <typename Adapter>
+void bench_small(const char *name, size_t keylen,
+                 const std::vector<std::string_view> &keys, size_t ops) {
+    const size_t n = keys.size();
+    size_t found = 0;
+    double load = 0;
+    const Result r = measure(ops, [&](size_t) {
+        Adapter ht(static_cast<size_t>(n / 0.7) + 1, n);
+        for (size_t i = 0; i < n; i++) ht.insert(keys[i], static_cast<int>(i));
+        for (size_t i = 0; i < n; i++) found += ht.get(keys[i]);
+        load = ht.load();
+    });
+    print_row(name, n, load, keylen, "small-map", r);
+    if (found != ops * n) std::printf("(lost entries)\n");
+}
+
+std::vector<double> parse_list(const char *arg) {
+    std::vector<double> out;
+    for (const char *p = arg; *p != '\0';) {
+        char *end = nullptr;
+        out.push_back(std::strtod(p, &end));
+        p = (*end == ',') ? end + 1 : end;
+        if (end == p && *end != '\0') break;
+    }
+    return out;
+}
+
+Config parse_args(int argc, char **argv) {
+    Config cfg;
+    auto to_sizes = [](const std::vector<double> &v) {
+        return std::vector<size_t>(v.begin(), v.end());
+    };
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const auto value = [&](std::string_view flag) {
+            return arg.substr(0, flag.size()) == flag
+                       ? argv[i] + flag.size()
+                       : nullptr;
+        };
+        if (auto v = value("--sizes="))
+            cfg.sizes = to_sizes(parse_list(v));
+        else if (auto v = value("--keylens="))
+            cfg.keylens = to_sizes(parse_list(v));
+        else if (auto v = value("--loads="))
+            cfg.loads = parse_list(v);
+        else if (auto v = value("--hit="))
+            cfg.hit = std::strtod(v, nullptr);
+        else if (auto v = value("--min-ops="))
+            cfg.min_ops = std::strtoull(v, nullptr, 10);
+        else if (auto v = value("--dist=")) {
+            if (!cfg.dist.parse(v))
+                std::fprintf(stderr, "Ignoring bad distribution '%s'\n", v);
+        } else if (auto v = value("--trace="))
+            cfg.trace = v;
+        else
+            std::fprintf(stderr, "Ignoring unknown option '%s'\n", argv[i]);
+    }
+    return cfg;
+}
+
+int main(int argc, char **argv) {
+    const Config cfg = parse_args(argc, argv);
+
+    using Ours = HashTable<std::string_view, int>;
+    using OursFast = HashTable<std::string_view, int, WyHash, std::equal_to<>,
+                               MaskReduce>;
+    using OursRobinHood =
+        HashTable<std::string_view, int, WyHash, std::equal_to<>, MaskReduce,
+                  RobinHoodProbing>;
+    using OursChained =
+        HashTable<std::string_view, int, WyHash, std::equal_to<>, MaskReduce,
+                  SeparateChaining>;
+    using OursSmall = SmallHashTable<std::string_view, int, 16, WyHash,
+                                     std::equal_to<>, MaskReduce>;
+    using StdMap = std::unordered_map<std::string_view, int>;
+
+    std::printf("%-24s %10s %5s %6s  %-12s %8s %8s %8s\n", "table", "size",
+                "load", "keylen", "op", "Mops/s", "p50 ns", "p99 ns");
+    if (!cfg.trace.empty()) {
+        const auto owned = load_trace(cfg.trace);
+        if (owned.empty()) {
+            std::fprintf(stderr, "No keys in trace '%s'\n", cfg.trace.c_str());
+            return 1;
+        }
+        const std::vector<std::string_view> trace(owned.begin(), owned.end());
+        bench_trace<OursAdapter<Ours>>("HashTable", trace);
+        bench_trace<OursAdapter<OursFast>>("HashTable<wy,mask>", trace);
+        bench_trace<StdAdapter<StdMap>>("unordered_map", trace);
+        return 0;
+    }
+    for (const size_t size : cfg.sizes) {
+        for (const size_t keylen : cfg.keylens) {
+            const auto keys = make_keys(size, keylen, 1);
+            const auto misses = make_keys(size, keylen, 2);
+            for (const double load : cfg.loads) {
+                bench_table<OursAdapter<Ours>>("HashTable", size, load,
+                                               keylen, keys, misses, cfg);
+                bench_table<OursAdapter<OursFast>>("HashTable<wy,mask>", size,
+                                                   load, keylen, keys, misses,
+                                                   cfg);
+                bench_table<OursAdapter<OursRobinHood>>(
+                    "HashTable<wy,mask,rh>", size, load, keylen, keys, misses,
+                    cfg);
+                bench_table<OursAdapter<OursChained>>(
+                    "HashTable<wy,mask,chain>", size, load, keylen, keys,
+                    misses, cfg);
+                bench_batch<OursFast>("HashTable<wy,mask>", size, load, keylen,
+                                      keys, misses, cfg);
+            }
+            bench_build<OursFast>("HashTable<wy,mask>", size, keylen, keys);
+            bench_table<StdAdapter<StdMap>>("unordered_map", size, 1.0,
+                                            keylen, keys, misses, cfg);
+#ifdef WITH_ABSL
+            bench_table<StdAdapter<absl::flat_hash_map<std::string_view, int>>>(
+                "absl::flat_hash_map", size, 1.0, keylen, keys, misses, cfg);
+#endif
+        }
+    }
+    for (const size_t keylen : cfg.keylens) {
+        const auto owned = make_keys(8, keylen, 6);
+        const std::vector<std::string_view> keys(owned.begin(), owned.end());
+        const size_t ops = cfg.min_ops / keys.size();
+        bench_small<OursAdapter<OursFast>>("HashTable<wy,mask>", keylen, keys,
+                                           ops);
+        bench_small<OursAdapter<OursSmall>>("SmallHashTable<16>", keylen, keys,
+                                            ops);
+        bench_small<StdAdapter<StdMap>>("unordered_map", keylen, keys, ops);
+    }
+    return 0;
+}
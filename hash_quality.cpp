@@ -0,0 +1,289 @@
+// hash_quality.cpp
+//
+// How well each hash functor spreads a key set, to pick one from data:
+//
+//   g++ -std=c++17 -O2 -march=native hash_quality.cpp -o hash_quality
+//   python main.py --dump-keys keys.txt && ./hash_quality --keys=keys.txt
+//   ./hash_quality --synthetic=1000000 --load=0.7 --reduce=mask
+//
+// Keys come one per line from `--keys` (duplicates dropped), or are the
+// sequential "key0", "key1", ... of `--synthetic`, which weak hashes handle
+// worst. Each row is one hash:
+//
+//   GB/s        hashing throughput over the whole key set
+//   aval        mean chance an output bit flips when one of a key's first 64
+//               input bits does (ideal 0.5), and the worst bias
+//               `|2p - 1|` over all input/output bit pairs (ideal 0)
+//   occ var     variance of keys per bucket with as many buckets as keys,
+//               over the Poisson variance a random hash would give (ideal 1)
+//   empty       share of those buckets left empty (about 1/e for a random
+//               hash)
+//   hit         mean slots a successful linear probe visits at `--load`;
+//               Knuth's `(1 + 1 / (1 - a)) / 2` for a random hash is printed
+//               above the table. Where `--reduce` rounds the capacity to a
+//               power of two, it is rounded down and an evenly spread subset
+//               of the keys fills it to `--load`
+//   miss        same for an unsuccessful probe from a random slot, against
+//               `(1 + 1 / (1 - a)^2) / 2`
+//   max disp    longest distance a key sits from its home slot
+//
+// Buckets and probe homes come from `--reduce` (`mask`, `modulo` or
+// `fastrange`), as the table would compute them; `mask` only sees low bits,
+// so it shows weaknesses the others hide.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "hash_table.hpp"
+#include "workload.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Keys whose bits the avalanche test flips
+constexpr size_t avalanche_keys = 2000;
+// Least time spent hashing for the throughput figure
+constexpr double min_hash_seconds = 0.2;
+
+struct Config {
+    std::string keys;
+    size_t synthetic = 100000;
+    double load = 0.7;
+    std::string reduce = "mask";
+};
+
+struct Quality {
+    double gbps = 0;
+    double avalanche_mean = 0;
+    double avalanche_worst = 0;
+    double occupancy_ratio = 0;
+    double empty_share = 0;
+    double probe_hit = 0;
+    double probe_miss = 0;
+    size_t max_displacement = 0;
+};
+
+template <typename Hash>
+double throughput(const std::vector<std::string_view> &keys) {
+    const Hash hash;
+    size_t bytes = 0;  // Per pass, counted outside the timed loop
+    for (const auto key : keys) bytes += key.size();
+    size_t passes = 0;
+    uint64_t sink = 0;
+    const auto start = Clock::now();
+    double secs = 0;
+    do {
+        for (const auto key : keys) sink ^= hash(key);
+        passes += 1;
+        secs = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (secs < min_hash_seconds);
+    if (sink == 1) std::printf(" ");  // Keep the hashing from being elided
+    return static_cast<double>(bytes) * passes / secs / 1e9;
+}
+
+// Flip each of the first 64 bits of up to `avalanche_keys` keys and count
+// which output bits follow; returns the mean flip rate and worst bias
+template <typename Hash>
+std::pair<double, double> avalanche(const std::vector<std::string_view> &keys) {
+    const Hash hash;
+    std::vector<uint64_t> flips(64 * 64);
+    std::vector<uint64_t> trials(64);
+    const size_t step = std::max<size_t>(1, keys.size() / avalanche_keys);
+    std::string key;
+    for (size_t k = 0; k < keys.size(); k += step) {
+        key.assign(keys[k]);
+        const uint64_t base = hash(key);
+        const size_t bits = std::min<size_t>(64, key.size() * 8);
+        for (size_t i = 0; i < bits; i++) {
+            key[i / 8] ^= static_cast<char>(1 << (i % 8));
+            const uint64_t diff = base ^ hash(key);
+            key[i / 8] ^= static_cast<char>(1 << (i % 8));
+            trials[i] += 1;
+            for (size_t j = 0; j < 64; j++)
+                flips[i * 64 + j] += (diff >> j) & 1;
+        }
+    }
+    double sum = 0;
+    double worst = 0;
+    size_t cells = 0;
+    for (size_t i = 0; i < 64; i++) {
+        if (trials[i] == 0) continue;
+        for (size_t j = 0; j < 64; j++) {
+            const double p = static_cast<double>(flips[i * 64 + j]) / trials[i];
+            sum += p;
+            worst = std::max(worst, std::fabs(2 * p - 1));
+            cells += 1;
+        }
+    }
+    return {cells != 0 ? sum / cells : 0, worst};
+}
+
+// Slots and keys the probing test uses to reach `load` from `n` keys: the
+// capacity as `Reduce` rounds it, halved while rounding up leaves more slots
+// than `n` keys can fill, and `load` of it in keys (fewer than the slots, so
+// at least one stays empty)
+template <typename Reduce>
+std::pair<size_t, size_t> probe_shape(size_t n, double load) {
+    size_t cap = Reduce::round_capacity(
+        std::max(n + 1, static_cast<size_t>(n / load) + 1));
+    while (cap > 2 && static_cast<size_t>(load * cap) > n)
+        cap = Reduce::round_capacity(cap / 2);
+    const size_t keys = std::min(n, static_cast<size_t>(load * cap));
+    return {cap, std::max<size_t>(1, keys)};
+}
+
+template <typename Hash, typename Reduce>
+Quality analyze(const std::vector<std::string_view> &keys, double load) {
+    const Hash hash;
+    const size_t n = keys.size();
+    std::vector<uint64_t> hashes(n);
+    for (size_t i = 0; i < n; i++) hashes[i] = hash(keys[i]);
+
+    Quality q;
+    q.gbps = throughput<Hash>(keys);
+    std::tie(q.avalanche_mean, q.avalanche_worst) = avalanche<Hash>(keys);
+
+    // Occupancy over about as many buckets as keys
+    const size_t buckets = Reduce::round_capacity(n);
+    std::vector<uint32_t> counts(buckets);
+    for (const uint64_t h : hashes) counts[Reduce::index(h, buckets)] += 1;
+    const double mean = static_cast<double>(n) / buckets;
+    double var = 0;
+    size_t empty = 0;
+    for (const uint32_t c : counts) {
+        var += (c - mean) * (c - mean);
+        empty += c == 0;
+    }
+    var /= buckets;
+    q.occupancy_ratio = var / (mean * (1 - 1.0 / buckets));
+    q.empty_share = static_cast<double>(empty) / buckets;
+
+    // Linear probing at `load`, placing each key in the first empty slot
+    // from its home as `GroupProbing` does
+    const auto [cap, m] = probe_shape<Reduce>(n, load);
+    std::vector<bool> full(cap);
+    size_t total = 0;
+    for (size_t k = 0; k < m; k++) {
+        size_t i = Reduce::index(hashes[k * n / m], cap);
+        size_t d = 0;
+        for (; full[i]; d++) i = Reduce::wrap(i + 1, cap);
+        full[i] = true;
+        total += d;
+        q.max_displacement = std::max(q.max_displacement, d);
+    }
+    q.probe_hit = 1.0 + static_cast<double>(total) / m;
+    // A miss from slot `i` visits the rest of its run plus the empty slot
+    // that ends it; walk backwards so each run is measured once
+    size_t start = 0;
+    while (full[start]) start++;  // Some slot is empty, since `cap > m`
+    size_t run = 0;
+    size_t miss_total = 0;
+    for (size_t k = 0; k < cap; k++) {
+        const size_t i = (start + cap - k) % cap;
+        run = full[i] ? run + 1 : 0;
+        miss_total += run + 1;
+    }
+    q.probe_miss = static_cast<double>(miss_total) / cap;
+    return q;
+}
+
+template <typename Hash>
+void print_row(const char *name, const std::vector<std::string_view> &keys,
+               const Config &cfg) {
+    Quality q;
+    if (cfg.reduce == "modulo")
+        q = analyze<Hash, ModuloReduce>(keys, cfg.load);
+    else if (cfg.reduce == "fastrange")
+        q = analyze<Hash, FastrangeReduce>(keys, cfg.load);
+    else
+        q = analyze<Hash, MaskReduce>(keys, cfg.load);
+    std::printf("%-16s %8.2f %6.3f %6.3f %8.3f %6.3f %7.2f %7.2f %8zu\n", name,
+                q.gbps, q.avalanche_mean, q.avalanche_worst, q.occupancy_ratio,
+                q.empty_share, q.probe_hit, q.probe_miss, q.max_displacement);
+}
+
+Config parse_args(int argc, char **argv) {
+    Config cfg;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const auto value = [&](std::string_view flag) -> const char * {
+            if (arg.substr(0, flag.size()) != flag) return nullptr;
+            return argv[i] + flag.size();
+        };
+        if (const char *v = value("--keys=")) {
+            cfg.keys = v;
+        } else if (const char *v = value("--synthetic=")) {
+            cfg.synthetic = std::strtoull(v, nullptr, 10);
+        } else if (const char *v = value("--load=")) {
+            cfg.load = std::strtod(v, nullptr);
+        } else if (const char *v = value("--reduce=")) {
+            cfg.reduce = v;
+        } else {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            std::exit(1);
+        }
+    }
+    if (cfg.load <= 0 || cfg.load >= 1) {
+        std::fprintf(stderr, "--load must be in (0, 1)\n");
+        std::exit(1);
+    }
+    if (cfg.reduce != "mask" && cfg.reduce != "modulo" &&
+        cfg.reduce != "fastrange") {
+        std::fprintf(stderr, "--reduce must be mask, modulo or fastrange\n");
+        std::exit(1);
+    }
+    return cfg;
+}
+
+int main(int argc, char **argv) {
+    const Config cfg = parse_args(argc, argv);
+
+    std::vector<std::string> owned;
+    if (!cfg.keys.empty()) {
+        owned = load_trace(cfg.keys);
+        std::sort(owned.begin(), owned.end());
+        owned.erase(std::unique(owned.begin(), owned.end()), owned.end());
+    } else {
+        owned.reserve(cfg.synthetic);
+        for (size_t i = 0; i < cfg.synthetic; i++)
+            owned.push_back("key" + std::to_string(i));
+    }
+    if (owned.empty()) {
+        std::fprintf(stderr, "No keys to analyze\n");
+        return 1;
+    }
+    const std::vector<std::string_view> keys(owned.begin(), owned.end());
+
+    // What a random hash would score, at the capacities `--reduce` rounds to
+    const size_t n = keys.size();
+    auto [cap, m] = probe_shape<MaskReduce>(n, cfg.load);
+    size_t buckets = MaskReduce::round_capacity(n);
+    if (cfg.reduce != "mask") {
+        std::tie(cap, m) = probe_shape<ModuloReduce>(n, cfg.load);
+        buckets = n;
+    }
+    const double a = static_cast<double>(m) / cap;
+    std::printf("%zu keys, --reduce=%s, probing %zu at load %.2f: a random "
+                "hash expects hit %.2f, miss %.2f, empty %.3f\n",
+                n, cfg.reduce.c_str(), m, a, (1 + 1 / (1 - a)) / 2,
+                (1 + 1 / ((1 - a) * (1 - a))) / 2,
+                std::exp(-static_cast<double>(n) / buckets));
+    std::printf("%-16s %8s %6s %6s %8s %6s %7s %7s %8s\n", "hash", "GB/s",
+                "aval", "worst", "occ var", "empty", "hit", "miss", "max disp");
+    print_row<Fnv1aHash>("fnv1a", keys, cfg);
+    print_row<Djb2Hash>("djb2", keys, cfg);
+    print_row<WyHash>("wyhash", keys, cfg);
+#if __has_include(<xxhash.h>)
+    print_row<Xxh3Hash>("xxh3", keys, cfg);
+#endif
+    print_row<std::hash<std::string_view>>("std::hash", keys, cfg);
+    return 0;
+}
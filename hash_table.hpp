@@ -0,0 +1,3574 @@
+// hash_table.hpp
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<xxhash.h>)
+#include <xxhash.h>
+#endif
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Control bytes, one per slot: a full slot stores a 7-bit tag taken from the
+// top of its hash, so a probe can rule out most slots without touching keys.
+constexpr int8_t ctrl_empty = -128;   // 0b10000000
+constexpr int8_t ctrl_deleted = -2;   // 0b11111110, tombstone left by remove
+
+// Control byte for a full slot: the top 7 bits of the hash.
+inline int8_t ctrl_tag(uint64_t hash) {
+    return static_cast<int8_t>(hash >> 57);
+}
+
+// Bit set of matching positions inside a probe group of `Width` slots,
+// iterated lowest first. `Shift` spreads one position over `1 << Shift` bits
+// (used by NEON).
+template <typename Mask, size_t Width, int Shift = 0>
+struct BitMask {
+    Mask bits;
+
+    explicit operator bool(void) const { return bits != 0; }
+    // Position of the lowest match, i.e. count of trailing non-matches
+    size_t lowest(void) const {
+        return static_cast<size_t>(__builtin_ctzll(bits)) >> Shift;
+    }
+    // Count of non-matches above the highest match
+    size_t leading_zeros(void) const {
+        constexpr int unused = 64 - static_cast<int>(Width << Shift);
+        return static_cast<size_t>(__builtin_clzll(bits) - unused) >> Shift;
+    }
+    void clear_lowest(void) { bits &= (bits - 1); }
+};
+
+// A window of `width` consecutive control bytes compared in one go with
+// SSE2/AVX2/NEON, or a portable loop elsewhere.
+struct ProbeGroup {
+#if defined(__AVX2__)
+    static constexpr size_t width = 32;
+    using Mask = BitMask<uint32_t, width>;
+
+    explicit ProbeGroup(const int8_t *p)
+        : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))) {}
+
+    Mask match(int8_t tag) const {
+        auto eq = _mm256_cmpeq_epi8(_mm256_set1_epi8(tag), ctrl);
+        return Mask{static_cast<uint32_t>(_mm256_movemask_epi8(eq))};
+    }
+    Mask match_empty(void) const { return match(ctrl_empty); }
+    // Empty and deleted control bytes are the negative ones, so only sign
+    // bits matter
+    Mask match_free(void) const {
+        return Mask{static_cast<uint32_t>(_mm256_movemask_epi8(ctrl))};
+    }
+
+    __m256i ctrl;
+#elif defined(__SSE2__)
+    static constexpr size_t width = 16;
+    using Mask = BitMask<uint32_t, width>;
+
+    explicit ProbeGroup(const int8_t *p)
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+
+    Mask match(int8_t tag) const {
+        auto eq = _mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl);
+        return Mask{static_cast<uint32_t>(_mm_movemask_epi8(eq))};
+    }
+    Mask match_empty(void) const { return match(ctrl_empty); }
+    Mask match_free(void) const {
+        return Mask{static_cast<uint32_t>(_mm_movemask_epi8(ctrl))};
+    }
+
+    __m128i ctrl;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static constexpr size_t width = 16;
+    using Mask = BitMask<uint64_t, width, 2>;
+
+    explicit ProbeGroup(const int8_t *p) : ctrl(vld1q_s8(p)) {}
+
+    Mask match(int8_t tag) const {
+        return to_mask(vceqq_s8(vdupq_n_s8(tag), ctrl));
+    }
+    Mask match_empty(void) const { return match(ctrl_empty); }
+    Mask match_free(void) const { return to_mask(vcltzq_s8(ctrl)); }
+
+    // Narrow each 0x00/0xff lane to a nibble, keep one bit per nibble
+    static Mask to_mask(uint8x16_t lanes) {
+        auto nibbles = vshrn_n_u16(vreinterpretq_u16_u8(lanes), 4);
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+        return Mask{bits & 0x8888888888888888ull};
+    }
+
+    int8x16_t ctrl;
+#else
+    static constexpr size_t width = 16;
+    using Mask = BitMask<uint32_t, width>;
+
+    explicit ProbeGroup(const int8_t *p) { std::memcpy(ctrl, p, width); }
+
+    Mask match(int8_t tag) const {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < width; i++)
+            bits |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+        return Mask{bits};
+    }
+    Mask match_empty(void) const { return match(ctrl_empty); }
+    Mask match_free(void) const {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < width; i++)
+            bits |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+        return Mask{bits};
+    }
+
+    int8_t ctrl[width];
+#endif
+};
+
+// Hash policies: stateless functors picked at compile time, so a lookup
+// calls the hash directly instead of through a pointer or a `switch`.
+
+// FNV-1a hash algorithm used for better distribution than `djb2`.
+struct Fnv1aHash {
+    using is_transparent = void;  // Hashes anything viewable as a string
+
+    constexpr uint64_t operator()(std::string_view key) const {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : key) {
+            hash ^= static_cast<uint64_t>(c);
+            hash *= 1099511628211ul;
+        }
+        return hash;
+    }
+};
+
+// `djb2` Bernstein hash function iterates through each character,
+// left-shifting the current hash by 5 bits and adding the ASCII value.
+// Short keys leave the top bits (the control byte tag) mostly zero.
+struct Djb2Hash {
+    using is_transparent = void;  // Hashes anything viewable as a string
+
+    constexpr uint64_t operator()(std::string_view key) const {
+        uint64_t hash = 5381;
+        for (const char c : key)  // hash * 33 + c;
+            hash = (((hash << 5) + hash) + static_cast<uint64_t>(c));
+        return hash;
+    }
+};
+
+// wyhash (final version 4) by Wang Yi: reads 8 bytes at a time and mixes
+// with 64x64->128 multiplies, much faster than byte-wise hashes on long keys.
+struct WyHash {
+    using is_transparent = void;  // Hashes anything viewable as a string
+
+    uint64_t seed = 0;
+
+    uint64_t operator()(std::string_view key) const {
+        const auto *p = reinterpret_cast<const uint8_t *>(key.data());
+        const size_t len = key.size();
+        uint64_t see0 = seed ^ mix(seed ^ secret[0], secret[1]);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                const size_t mid = (len >> 3) << 2;
+                a = (read4(p) << 32) | read4(p + mid);
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - mid);
+            } else if (len > 0) {
+                a = (uint64_t{p[0]} << 16) | (uint64_t{p[len >> 1]} << 8) |
+                    p[len - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i >= 48) {
+                uint64_t see1 = see0, see2 = see0;
+                do {
+                    see0 = mix(read8(p) ^ secret[1], read8(p + 8) ^ see0);
+                    see1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i >= 48);
+                see0 ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                see0 = mix(read8(p) ^ secret[1], read8(p + 8) ^ see0);
+                i -= 16;
+                p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= secret[1];
+        b ^= see0;
+        multiply(a, b);
+        return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+    }
+
+   private:
+    static constexpr uint64_t secret[4] = {
+        0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+        0x4d5a2da51de1aa47ull};
+
+    static void multiply(uint64_t &a, uint64_t &b) {
+        const auto r = static_cast<unsigned __int128>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+    }
+    static uint64_t mix(uint64_t a, uint64_t b) {
+        multiply(a, b);
+        return a ^ b;
+    }
+    static uint64_t read8(const uint8_t *p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    static uint64_t read4(const uint8_t *p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+};
+
+#if __has_include(<xxhash.h>)
+// XXH3 64-bit from the system xxHash library (`-lxxhash`), when installed.
+struct Xxh3Hash {
+    using is_transparent = void;  // Hashes anything viewable as a string
+
+    uint64_t operator()(std::string_view key) const {
+        return XXH3_64bits(key.data(), key.size());
+    }
+};
+#endif
+
+// Index reduction policies map a 64-bit hash onto `[0, cap)`, and `wrap` a
+// probe position that ran past the end (always below `2 * cap`).
+
+// Plain `hash % cap`: any capacity, but a 64-bit division per lookup.
+struct ModuloReduce {
+    static size_t round_capacity(size_t n) { return n; }
+    static size_t index(uint64_t hash, size_t cap) { return hash % cap; }
+    static size_t wrap(size_t i, size_t cap) { return i < cap ? i : i - cap; }
+};
+
+// Rounds capacity up to a power of two so reduction is a single mask.
+struct MaskReduce {
+    static size_t round_capacity(size_t n) {
+        size_t cap = 1;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+    static size_t index(uint64_t hash, size_t cap) { return hash & (cap - 1); }
+    static size_t wrap(size_t i, size_t cap) { return i & (cap - 1); }
+};
+
+// Lemire's fastrange, `(hash * cap) >> 64`: any capacity, one multiply.
+// It picks the high bits, so the top 7 (the control byte tag) are shifted
+// out first to keep neighbouring slots' tags independent.
+struct FastrangeReduce {
+    static size_t round_capacity(size_t n) { return n; }
+    static size_t index(uint64_t hash, size_t cap) {
+        return static_cast<size_t>(
+            (static_cast<unsigned __int128>(hash << 7) * cap) >> 64);
+    }
+    static size_t wrap(size_t i, size_t cap) { return i < cap ? i : i - cap; }
+};
+
+// Which of `1 << bits` partitions (shards, segments) a hash belongs to. It
+// uses the high bits just below the 7-bit control byte tag, so tags inside a
+// partition stay fully random and the low bits are left for indexing.
+inline size_t hash_partition(uint64_t hash, unsigned bits) {
+    return bits == 0 ? 0 : static_cast<size_t>((hash << 7) >> (64 - bits));
+}
+
+// Lookups take any key type `Hash` and `Eq` both accept when both declare
+// `is_transparent` (e.g. `const char *` or `std::string` against
+// `std::string_view` keys), and otherwise convert to the key type first.
+template <typename T, typename = void>
+struct is_transparent : std::false_type {};
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>>
+    : std::true_type {};
+
+// A `Hash` declaring `static constexpr bool cache_hash = false` keeps slots
+// from storing each entry's full hash; see `HashTable::Slot`
+template <typename T, typename = void>
+struct caches_hash : std::true_type {};
+template <typename T>
+struct caches_hash<T, std::void_t<decltype(T::cache_hash)>>
+    : std::bool_constant<T::cache_hash> {};
+
+// The `hash` member of a slot that doesn't store it: takes no room, ignores
+// stores, and matches every hash, so probes fall through from the control
+// byte tag to `Eq`
+struct NoCachedHash {
+    NoCachedHash() = default;
+    NoCachedHash(uint64_t) {}
+
+    bool operator==(uint64_t) const { return true; }
+};
+
+template <bool Transparent>
+struct KeyArg {
+    template <typename Q, typename K>
+    using type = K;
+};
+template <>
+struct KeyArg<true> {
+    template <typename Q, typename K>
+    using type = Q;
+};
+
+// Bump allocator for key bytes owned by a table: one heap allocation per
+// `chunk_size` of keys instead of one per key. Bytes are only reclaimed all
+// at once by `clear`, which keeps the first chunk for reuse.
+struct StringArena {
+    static constexpr size_t default_chunk_size = size_t{1} << 20;
+
+    explicit StringArena(size_t chunk_size = default_chunk_size)
+        : m_chunk_size(chunk_size) {}
+
+    // Copy `str` into the arena and return a view of the copy
+    std::string_view store(std::string_view str) {
+        if (str.size() > m_left) add_chunk(str.size());
+        char *dst = m_cur;
+        if (!str.empty()) std::memcpy(dst, str.data(), str.size());
+        m_cur += str.size();
+        m_left -= str.size();
+        m_bytes += str.size();
+        return {dst, str.size()};
+    }
+
+    // Invalidate every stored key, in O(chunks)
+    void clear(void) {
+        if (m_chunks.size() > 1) m_chunks.resize(1);
+        m_cur = m_chunks.empty() ? nullptr : m_chunks.front().bytes.get();
+        m_left = m_chunks.empty() ? 0 : m_chunks.front().size;
+        m_bytes = 0;
+    }
+
+    // Take over `other`'s chunks, so keys stored there live as long as this
+    // arena's; new keys keep filling the current chunk
+    void adopt(StringArena &&other) {
+        for (auto &chunk : other.m_chunks) m_chunks.push_back(std::move(chunk));
+        m_bytes += other.m_bytes;
+        other.m_chunks.clear();
+        other.m_cur = nullptr;
+        other.m_left = 0;
+        other.m_bytes = 0;
+    }
+
+    size_t chunk_count(void) const { return m_chunks.size(); }
+
+    size_t chunk_size(void) const { return m_chunk_size; }
+
+    // Bytes stored since the last `clear`, live or not
+    size_t bytes(void) const { return m_bytes; }
+
+    // Bytes held in chunks, used or not
+    size_t allocated(void) const {
+        size_t total = 0;
+        for (const auto &chunk : m_chunks) total += chunk.size;
+        return total;
+    }
+
+   private:
+    struct Chunk {
+        std::unique_ptr<char[]> bytes;
+        size_t size;
+    };
+
+    // Keys longer than a chunk get a chunk of their own size
+    void add_chunk(size_t min_size) {
+        const size_t n = std::max(min_size, m_chunk_size);
+        m_chunks.push_back({std::unique_ptr<char[]>(new char[n]), n});
+        m_cur = m_chunks.back().bytes.get();
+        m_left = n;
+    }
+
+    size_t m_chunk_size;
+    std::vector<Chunk> m_chunks;
+    char *m_cur = nullptr;
+    size_t m_left = 0;
+    size_t m_bytes = 0;
+};
+
+// Append-only key bytes addressed by 32-bit handles, for `PackedHashTable`.
+// A key is stored as its 4-byte length and then its bytes, padded to `Unit`
+// bytes, in chunks of `chunk_size`. A handle counts units from the start of
+// the first chunk, so up to `2^32 * Unit` bytes of keys fit. Like
+// `StringArena`, bytes are only reclaimed all at once by `clear`; the owner
+// compacts by copying the live keys to a fresh arena.
+template <size_t Unit = 8>
+struct OffsetArena {
+    static constexpr size_t unit = Unit;
+    static constexpr size_t chunk_size = size_t{1} << 20;
+    static constexpr uint64_t max_bytes = uint64_t{unit} << 32;
+
+    static_assert(unit >= sizeof(uint32_t) && (unit & (unit - 1)) == 0 &&
+                      unit <= chunk_size,
+                  "an offset arena unit is a power of two that holds a length");
+
+    // Arena bytes a key of `size` bytes takes
+    static constexpr size_t footprint(size_t size) {
+        return (sizeof(uint32_t) + size + unit - 1) / unit * unit;
+    }
+
+    // Copy `key` into the arena and return its handle. Throws
+    // `std::length_error` once the arena is full or for a key that can't
+    // fit in one chunk.
+    uint32_t store(std::string_view key) {
+        const size_t need = footprint(key.size());
+        if (need > chunk_size)
+            throw std::length_error("key too long for an offset arena");
+        if (!has_room(key.size()))
+            throw std::length_error("offset arena is full");
+        m_end = start_for(need);
+        if (m_end / chunk_size == m_chunks.size())
+            m_chunks.emplace_back(new char[chunk_size]);
+        char *dst = at(m_end);
+        const auto len = static_cast<uint32_t>(key.size());
+        std::memcpy(dst, &len, sizeof(len));
+        if (!key.empty())
+            std::memcpy(dst + sizeof(len), key.data(), key.size());
+        m_last = m_end;
+        m_end += need;
+        return static_cast<uint32_t>(m_last / unit);
+    }
+
+    // Take back the key `store` just returned, e.g. once it turns out to be
+    // a duplicate
+    void drop_last(void) { m_end = m_last; }
+
+    std::string_view load(uint32_t handle) const {
+        const char *src = at(uint64_t{handle} * unit);
+        uint32_t len;
+        std::memcpy(&len, src, sizeof(len));
+        return {src + sizeof(len), len};
+    }
+
+    // Invalidate every handle, keeping the chunks for reuse
+    void clear(void) { m_end = m_last = 0; }
+
+    // Whether a key of `size` bytes can still be stored
+    bool has_room(size_t size) const {
+        return start_for(footprint(size)) + footprint(size) <= max_bytes;
+    }
+
+    // Bytes stored since the last `clear`, live or not, with the padding
+    // left at the ends of chunks
+    uint64_t used(void) const { return m_end; }
+
+    // Bytes held in chunks, used or not
+    size_t allocated(void) const { return m_chunks.size() * chunk_size; }
+
+   private:
+    char *at(uint64_t offset) const {
+        return m_chunks[offset / chunk_size].get() + offset % chunk_size;
+    }
+
+    // Where a key taking `need` bytes goes: next, or at the next chunk if
+    // it doesn't fit in the current one
+    uint64_t start_for(size_t need) const {
+        if (m_end % chunk_size + need > chunk_size)
+            return (m_end / chunk_size + 1) * chunk_size;
+        return m_end;
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    uint64_t m_end = 0;   // Next free byte
+    uint64_t m_last = 0;  // Where the last stored key starts
+};
+
+// Minimal perfect hash table over a fixed set of `N` string keys, built
+// PTHash-style: keys are split into buckets by hash, and each bucket, largest
+// first, gets the first "pilot" that sends all its keys to slots no earlier
+// bucket took. A lookup is one hash, one pilot read and one key compare.
+// Declared `constexpr` (see `make_static_table`), the whole build runs at
+// compile time, so there is no startup cost and no heap; that needs a `Hash`
+// usable in constant expressions, like `Fnv1aHash` or `Djb2Hash`. Keys must be
+// distinct and, for a `constexpr` table, point at static storage.
+template <typename V, size_t N, typename Hash = Fnv1aHash>
+struct StaticHashTable {
+    static_assert(N > 0, "a static table needs at least one key");
+
+    using Entry = std::pair<std::string_view, V>;
+
+    static constexpr size_t bucket_count = N / 2 + 1;
+
+    constexpr explicit StaticHashTable(const Entry (&entries)[N]) {
+        // Counting sort of key indices by bucket
+        uint64_t hashes[N] = {};
+        size_t starts[bucket_count + 1] = {};
+        for (size_t i = 0; i < N; i++) {
+            hashes[i] = Hash()(entries[i].first);
+            starts[bucket(hashes[i]) + 1] += 1;
+        }
+        size_t largest = 0;
+        for (size_t b = 0; b < bucket_count; b++) {
+            largest = std::max(largest, starts[b + 1]);
+            starts[b + 1] += starts[b];
+        }
+        size_t order[N] = {};
+        size_t fill[bucket_count] = {};
+        for (size_t i = 0; i < N; i++) {
+            const size_t b = bucket(hashes[i]);
+            order[starts[b] + fill[b]++] = i;
+        }
+
+        bool taken[N] = {};
+        size_t slots[N] = {};  // Candidate slots of the bucket being placed
+        for (size_t size = largest; size > 0; size--) {
+            for (size_t b = 0; b < bucket_count; b++) {
+                if (starts[b + 1] - starts[b] != size) continue;
+                const size_t *members = &order[starts[b]];
+                for (size_t j = 1; j < size; j++)
+                    for (size_t k = 0; k < j; k++)
+                        if (hashes[members[j]] == hashes[members[k]])
+                            throw std::invalid_argument(
+                                "duplicate (or fully colliding) static keys");
+                uint32_t pilot = 0;
+                while (!fits(hashes, members, size, pilot, taken, slots)) {
+                    if (++pilot == max_pilot)
+                        throw std::length_error("no pilot found for a bucket");
+                }
+                m_pilots[b] = pilot;
+                for (size_t j = 0; j < size; j++) {
+                    taken[slots[j]] = true;
+                    m_keys[slots[j]] = entries[members[j]].first;
+                    m_vals[slots[j]] = entries[members[j]].second;
+                }
+            }
+        }
+    }
+
+    // immutable methods:
+
+    // Retrieve the entry value at `key`
+    constexpr std::optional<V> get(std::string_view key) const {
+        const size_t i = index(key);
+        if (i == N) return std::nullopt;  // Key not found
+        return m_vals[i];
+    }
+
+    // Check for the existence of a key without retrieving its value
+    constexpr bool contains(std::string_view key) const {
+        return index(key) != N;
+    }
+
+    // Slot of `key` in `[0, N)`, or `N` if absent
+    constexpr size_t index(std::string_view key) const {
+        const uint64_t hash = Hash()(key);
+        const size_t i = slot(hash, m_pilots[bucket(hash)]);
+        return m_keys[i] == key ? i : N;
+    }
+
+    constexpr size_t size(void) const { return N; }
+
+   private:
+    // Gives up on a bucket after this many pilots; only plausible for a
+    // hash that maps different keys almost identically
+    static constexpr uint32_t max_pilot = uint32_t{1} << 24;
+
+    // splitmix64 finalizer, so each pilot reshuffles a key's slot fully
+    static constexpr uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+    static constexpr size_t bucket(uint64_t hash) {
+        return static_cast<size_t>((hash >> 32) % bucket_count);
+    }
+    static constexpr size_t slot(uint64_t hash, uint32_t pilot) {
+        return static_cast<size_t>(mix(hash ^ mix(pilot)) % N);
+    }
+
+    // Whether `pilot` sends every member to a distinct free slot, leaving
+    // the slots in `slots`
+    static constexpr bool fits(const uint64_t *hashes, const size_t *members,
+                               size_t size, uint32_t pilot, const bool *taken,
+                               size_t *slots) {
+        for (size_t j = 0; j < size; j++) {
+            slots[j] = slot(hashes[members[j]], pilot);
+            if (taken[slots[j]]) return false;
+            for (size_t k = 0; k < j; k++)
+                if (slots[k] == slots[j]) return false;
+        }
+        return true;
+    }
+
+    std::string_view m_keys[N] = {};
+    V m_vals[N] = {};
+    uint32_t m_pilots[bucket_count] = {};
+};
+
+// Build a `StaticHashTable` from a braced list, deducing its size:
+//   constexpr auto commands = make_static_table<int>({{"get", 1}, {"set", 2}});
+template <typename V, typename Hash = Fnv1aHash, size_t N>
+constexpr StaticHashTable<V, N, Hash> make_static_table(
+    const std::pair<std::string_view, V> (&entries)[N]) {
+    return StaticHashTable<V, N, Hash>(entries);
+}
+
+// Stats policies: `HashTable` reports probes and resizes to one. With the
+// default `NoStats` every hook is an empty inline call and compiles away.
+struct NoStats {
+    static constexpr bool enabled = false;
+
+    void on_probe(size_t) {}
+    void on_resize(void) {}
+    void on_rehash(std::chrono::nanoseconds) {}
+};
+
+// Counts how many probe groups each table probe visits (slots under
+// `RobinHoodProbing`, chain nodes under `SeparateChaining`), resizes, and
+// time spent moving entries between tables.
+struct ProbeStats {
+    static constexpr bool enabled = true;
+    // `probes[i]` counts probes that visited `i + 1` groups; the last
+    // bucket also takes every longer probe
+    static constexpr size_t buckets = 8;
+
+    uint64_t probes[buckets] = {};
+    uint64_t probe_groups = 0;  // Sum over all probes
+    uint64_t resizes = 0;
+    std::chrono::nanoseconds rehash_time{0};
+
+    void on_probe(size_t groups) {
+        probes[std::min(groups, buckets) - 1] += 1;
+        probe_groups += groups;
+    }
+    void on_resize(void) { resizes += 1; }
+    void on_rehash(std::chrono::nanoseconds t) { rehash_time += t; }
+};
+
+// Point-in-time view of a table, from `HashTable::stats()`. Occupancy and
+// displacement come from scanning the slots; the probe histogram, resize
+// count and rehash time are only filled in with `ProbeStats`.
+struct TableStats {
+    size_t size = 0;
+    size_t capacity = 0;
+    size_t tombstones = 0;
+    double load_factor = 0;
+    // Slots between an entry's home index and where it sits; cluster
+    // lengths from `linear_probe`-style probing show up here
+    size_t max_displacement = 0;
+    double mean_displacement = 0;
+    std::vector<uint64_t> probe_histogram;  // See `ProbeStats::probes`
+    uint64_t probe_groups = 0;
+    uint64_t resizes = 0;
+    double rehash_seconds = 0;
+
+    // Prometheus text exposition, each metric named `prefix` + `_...`
+    std::string to_prometheus(const std::string &prefix = "hash_table") const {
+        std::string out;
+        char line[160];
+        const auto metric = [&](const char *name, const char *type, double v) {
+            std::snprintf(line, sizeof(line), "# TYPE %s_%s %s\n%s_%s %.17g\n",
+                          prefix.c_str(), name, type, prefix.c_str(), name, v);
+            out += line;
+        };
+        metric("size", "gauge", static_cast<double>(size));
+        metric("capacity", "gauge", static_cast<double>(capacity));
+        metric("tombstones", "gauge", static_cast<double>(tombstones));
+        metric("load_factor", "gauge", load_factor);
+        metric("max_displacement", "gauge",
+               static_cast<double>(max_displacement));
+        metric("mean_displacement", "gauge", mean_displacement);
+        metric("resizes_total", "counter", static_cast<double>(resizes));
+        metric("rehash_seconds_total", "counter", rehash_seconds);
+        if (probe_histogram.empty()) return out;
+
+        std::snprintf(line, sizeof(line), "# TYPE %s_probe_groups histogram\n",
+                      prefix.c_str());
+        out += line;
+        uint64_t count = 0;
+        for (size_t i = 0; i < probe_histogram.size(); i++) {
+            count += probe_histogram[i];
+            const std::string le = i + 1 < probe_histogram.size()
+                                       ? std::to_string(i + 1)
+                                       : "+Inf";
+            std::snprintf(line, sizeof(line),
+                          "%s_probe_groups_bucket{le=\"%s\"} %llu\n",
+                          prefix.c_str(), le.c_str(),
+                          static_cast<unsigned long long>(count));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line),
+                      "%s_probe_groups_sum %llu\n%s_probe_groups_count %llu\n",
+                      prefix.c_str(),
+                      static_cast<unsigned long long>(probe_groups),
+                      prefix.c_str(), static_cast<unsigned long long>(count));
+        out += line;
+        return out;
+    }
+};
+
+// Bytes a table holds, by component, from `memory_usage()`: what is
+// allocated (capacities, whole chunks and slabs), not just what's in use,
+// and not counting the heap allocator's own overhead.
+struct MemoryUsage {
+    size_t object = 0;  // The table object itself
+    size_t slots = 0;   // Slot arrays of open-addressing tables
+    size_t ctrl = 0;    // Control bytes, Robin Hood distances, chain heads
+    size_t nodes = 0;   // Chain node slabs
+    size_t arena = 0;   // Key byte chunks
+
+    size_t total(void) const { return object + slots + ctrl + nodes + arena; }
+
+    MemoryUsage &operator+=(const MemoryUsage &other) {
+        object += other.object;
+        slots += other.slots;
+        ctrl += other.ctrl;
+        nodes += other.nodes;
+        arena += other.arena;
+        return *this;
+    }
+};
+
+// Eviction policies: what a `HashTable` does once it holds its budget. Each
+// slot carries the policy's `Mark`; the default `NoEviction` never evicts,
+// and its empty `Mark` takes no room.
+struct NoEviction {
+    static constexpr bool enabled = false;
+
+    struct Mark {};
+};
+
+// CLOCK (second chance) eviction, for a table used as a bounded cache. A hit
+// from `get` or an insert sets the entry's referenced bit. Once a new key
+// takes the table over budget, a hand sweeps entries in memory order,
+// clearing set bits, and evicts the first entry whose bit was already clear;
+// it resumes there next time, so each insert costs O(1) amortized. New entries
+// start referenced.
+//
+// The table stops doubling at `capacity_for(2 * max_entries)`, so the
+// tombstones evictions leave are cleared by rehashing in place. `max_bytes`
+// bounds what `memory_usage()` reports between calls, resizes in flight
+// included: twice the table (its old copy may be held while a rehash runs)
+// plus the key arena must fit, so the table only doubles if that still holds
+// after, and it evicts to keep the live key bytes, plus half again for
+// evicted ones awaiting compaction, within what is left. The table is built
+// no bigger than the budget allows, and throws `std::invalid_argument` if
+// even its smallest size doesn't fit or `max_entries` is 0. An insert never
+// evicts the entry it just placed.
+struct ClockEviction {
+    static constexpr bool enabled = true;
+
+    struct Mark {
+        bool referenced = false;
+    };
+
+    size_t max_entries = SIZE_MAX;
+    size_t max_bytes = SIZE_MAX;
+};
+
+// Slab pool of `Node`s (which need a `Node *next` member): slabs of
+// `chunk_nodes` come from `resource`, and freed nodes go on a free list for
+// reuse. Nodes stay constructed while pooled, and all are destroyed with the
+// pool, so a slab is only returned to `resource` then.
+template <typename Node>
+struct NodePool {
+    static constexpr size_t chunk_nodes = 256;
+
+    explicit NodePool(std::pmr::memory_resource *resource =
+                          std::pmr::get_default_resource())
+        : m_resource(resource) {}
+
+    NodePool(NodePool &&other) noexcept
+        : m_resource(other.m_resource),
+          m_chunks(std::move(other.m_chunks)),
+          m_free(std::exchange(other.m_free, nullptr)) {
+        other.m_chunks.clear();
+    }
+    NodePool &operator=(NodePool &&other) noexcept {
+        if (this == &other) return *this;
+        release_chunks();
+        m_resource = other.m_resource;
+        m_chunks = std::move(other.m_chunks);
+        other.m_chunks.clear();
+        m_free = std::exchange(other.m_free, nullptr);
+        return *this;
+    }
+    ~NodePool() { release_chunks(); }
+
+    Node *make(void) {
+        if (m_free == nullptr) add_chunk();
+        Node *node = m_free;
+        m_free = node->next;
+        node->next = nullptr;
+        return node;
+    }
+
+    void release(Node *node) {
+        node->next = m_free;
+        m_free = node;
+    }
+
+    // Bytes held in slabs, pooled nodes included
+    size_t bytes(void) const {
+        return m_chunks.size() * chunk_nodes * sizeof(Node);
+    }
+
+   private:
+    void add_chunk(void) {
+        auto *chunk = static_cast<Node *>(
+            m_resource->allocate(sizeof(Node) * chunk_nodes, alignof(Node)));
+        for (size_t i = 0; i < chunk_nodes; i++) new (&chunk[i]) Node();
+        m_chunks.push_back(chunk);
+        for (size_t i = 0; i < chunk_nodes; i++) release(&chunk[i]);
+    }
+
+    void release_chunks(void) {
+        for (Node *chunk : m_chunks) {
+            for (size_t i = 0; i < chunk_nodes; i++) chunk[i].~Node();
+            m_resource->deallocate(chunk, sizeof(Node) * chunk_nodes,
+                                   alignof(Node));
+        }
+        m_chunks.clear();
+        m_free = nullptr;
+    }
+
+    std::pmr::memory_resource *m_resource;
+    std::vector<Node *> m_chunks;
+    Node *m_free = nullptr;
+};
+
+// Snapshot file layout, written by `HashTable::save` and mapped back by
+// `MappedHashTable`: a `SnapshotHeader`, then `cap + snapshot_mirror` control
+// bytes laid out for `GroupProbing`, then `cap` `SnapshotSlot`s, then the key
+// bytes string keys point into. Sections start on 64-byte boundaries, and
+// integers are in host byte order.
+constexpr char snapshot_magic[8] = {'H', 'T', 'S', 'N', 'A', 'P', '2', '\0'};
+// Mirrored control bytes past the end, enough for any `ProbeGroup::width`
+constexpr size_t snapshot_mirror = 31;
+
+// Where `Reduce` sends a few fixed hashes at capacity `cap`, so a snapshot
+// is only mapped by a table that places keys in the same home slots
+template <typename Reduce>
+uint64_t reduce_check(uint64_t cap) {
+    uint64_t check = 0;
+    for (uint64_t i = 1; i <= 8; i++)
+        check = check * 0x100000001b3ull +
+                Reduce::index(i * 0x9e3779b97f4a7c15ull, cap);
+    return check;
+}
+
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t cap;
+    uint64_t size;
+    uint64_t slot_size;   // `sizeof(SnapshotSlot<K, V>)`
+    uint64_t hash_check;  // `Hash()(key_type{})`, to catch a different `Hash`
+    uint64_t reduce_check;  // `reduce_check<Reduce>(cap)`, likewise
+    uint64_t ctrl_offset;
+    uint64_t slots_offset;
+    uint64_t keys_offset;
+    uint64_t keys_size;
+};
+
+// How a snapshot stores a key of type `K`: trivially copyable keys as they
+// are, string keys as an offset and length into the key bytes
+template <typename K>
+struct SnapshotKey {
+    static_assert(std::is_trivially_copyable_v<K>,
+                  "snapshot keys must be strings or trivially copyable");
+    using type = K;
+
+    static type store(const K &key, std::string &) { return key; }
+    static K load(const type &stored, const char *) { return stored; }
+};
+template <>
+struct SnapshotKey<std::string_view> {
+    struct type {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static type store(std::string_view key, std::string &bytes) {
+        const type stored{bytes.size(), key.size()};
+        bytes.append(key);
+        return stored;
+    }
+    static std::string_view load(const type &stored, const char *bytes) {
+        return {bytes + stored.offset, static_cast<size_t>(stored.size)};
+    }
+};
+
+template <typename K, typename V>
+struct SnapshotSlot {
+    static_assert(std::is_trivially_copyable_v<V>,
+                  "snapshot values must be trivially copyable");
+    uint64_t hash;
+    typename SnapshotKey<K>::type key;
+    V val;
+};
+
+// Key type tag: a `HashTable<ArenaString, V>` takes `std::string_view` keys
+// and copies the bytes of each new key into its own `StringArena`, so
+// callers need not keep key strings alive.
+struct ArenaString {};
+
+// What a slot stores for key type `K`, and whether the table owns key bytes
+template <typename K>
+struct KeyStorage {
+    using type = K;
+    static constexpr bool owns_bytes = false;
+};
+template <>
+struct KeyStorage<ArenaString> {
+    using type = std::string_view;
+    static constexpr bool owns_bytes = true;
+};
+
+// Collision policies: each provides `Table<Slot, Reduce>`, the storage of one
+// `HashTable` generation, built as `Table(capacity, policy)` from the policy
+// object the `HashTable` was constructed with. A `Slot` has `hash`, `key` and
+// `val` members, and `hash` is kept even in deleted slots. A table supports
+// `find(hash, match, stats)`, `find_or_claim(hash, match, stats)` to find a key
+// or reserve the slot it would be inserted into in the same probe,
+// `emplace(slot, hash)` for keys known to be absent, `erase(slot)`,
+// `drain(i, fn)` to hand bucket `i`'s entries to a resize, `visit(fn, hash_of)`
+// over entries with their displacement (`hash_of(slot)` gives an entry's full
+// hash), `prefetch(hash)`, `clear()` and `add_memory(usage)` to count its
+// allocations into a `MemoryUsage`. Entries are enumerated in memory order with
+// `first(bucket)` (the first entry in buckets from `bucket` on, or null),
+// `next(slot)` and `bucket_of(slot)`. `parallel_build` says whether the table
+// has `claim_before` for `HashTable`'s bulk constructor to fill bucket ranges
+// concurrently.
+
+// SwissTable-style probing a `ProbeGroup` of control bytes at a time.
+struct GroupProbing {
+    // Like the Python `LOAD_CAPACITY_THRESHOLD`
+    static constexpr double max_load = 0.7;
+
+    // Slots plus their control bytes. `ctrl` carries `ProbeGroup::width - 1`
+    // extra bytes mirroring the first slots, so a group load starting near the
+    // end wraps around without a second load.
+    template <typename Slot, typename Reduce>
+    struct Table {
+        size_t cap = 0;
+        size_t tombstones = 0;  // `ctrl_deleted` slots
+        std::vector<int8_t> ctrl;
+        std::vector<Slot> slots;
+
+        Table() = default;
+        Table(size_t n, const GroupProbing &)
+            : cap(n), ctrl(n + ProbeGroup::width - 1, ctrl_empty), slots(n) {}
+
+        static constexpr bool parallel_build = true;
+
+        bool is_full(size_t i) const { return ctrl[i] >= 0; }
+
+        void set_ctrl(size_t i, int8_t c) {
+            for (; i < ctrl.size(); i += cap) ctrl[i] = c;
+        }
+
+        // Bulk-build step on a table without tombstones: from the home index
+        // of `hash`, return the slot already holding a key that `match`es, or
+        // claim the first empty one (setting only its control byte). Scans
+        // slot by slot and never reaches `end`, returning null instead, so
+        // threads may run it concurrently for homes in disjoint ranges.
+        template <typename Match>
+        std::pair<Slot *, bool> claim_before(uint64_t hash, size_t end,
+                                             Match &&match) {
+            const int8_t h = ctrl_tag(hash);
+            for (size_t i = Reduce::index(hash, cap); i < end; i++) {
+                if (ctrl[i] == ctrl_empty) {
+                    set_ctrl(i, h);  // Mirror bytes aren't read until done
+                    return {&slots[i], true};
+                }
+                if (ctrl[i] == h && slots[i].hash == hash &&
+                    match(slots[i].key))
+                    return {&slots[i], false};
+            }
+            return {nullptr, false};
+        }
+
+        // Control bytes go back to empty in one `memset`. Slots only need
+        // resetting for what they own, so ones that own nothing (trivially
+        // destructible keys and values) are left as they were.
+        void clear(void) {
+            if constexpr (!std::is_trivially_destructible_v<Slot>) {
+                for (size_t i = 0; i < cap; i++)
+                    if (ctrl[i] != ctrl_empty) slots[i] = Slot{};
+            }
+            std::fill(ctrl.begin(), ctrl.end(), ctrl_empty);
+            tombstones = 0;
+        }
+
+        // Probe a group at a time, running `match` only on slots whose tag
+        // and full hash match. A group with an empty slot ends the search
+        // (tombstones don't); visiting every group also does, since the old
+        // table may be full while it drains.
+        template <typename Match, typename Stats>
+        Slot *find(uint64_t hash, Match &&match, Stats &stats) {
+            if (cap == 0) return nullptr;
+            const int8_t h = ctrl_tag(hash);
+            size_t index = Reduce::index(hash, cap);
+            size_t groups = 0;
+            for (size_t seen = 0; seen < cap; seen += ProbeGroup::width) {
+                groups += 1;
+                ProbeGroup group(&ctrl[index]);
+                for (auto m = group.match(h); m; m.clear_lowest()) {
+                    Slot &slot = slots[Reduce::wrap(index + m.lowest(), cap)];
+                    if (slot.hash == hash && match(slot.key)) {
+                        stats.on_probe(groups);
+                        return &slot;
+                    }
+                }
+                if (group.match_empty()) break;  // Key not found
+                // Next group
+                index = Reduce::wrap(index + ProbeGroup::width, cap);
+            }
+            stats.on_probe(groups);
+            return nullptr;
+        }
+
+        // `find`, but remembering the first free slot on the way; on a miss
+        // that slot is claimed (control byte set) and returned with `true`
+        // for the caller to fill. It's where `emplace` would have put the key.
+        template <typename Match, typename Stats>
+        std::pair<Slot *, bool> find_or_claim(uint64_t hash, Match &&match,
+                                              Stats &stats) {
+            const int8_t h = ctrl_tag(hash);
+            size_t index = Reduce::index(hash, cap);
+            size_t free = cap;  // None seen yet
+            size_t groups = 0;
+            for (size_t seen = 0; seen < cap; seen += ProbeGroup::width) {
+                groups += 1;
+                ProbeGroup group(&ctrl[index]);
+                for (auto m = group.match(h); m; m.clear_lowest()) {
+                    Slot &slot = slots[Reduce::wrap(index + m.lowest(), cap)];
+                    if (slot.hash == hash && match(slot.key)) {
+                        stats.on_probe(groups);
+                        return {&slot, false};
+                    }
+                }
+                if (free == cap) {
+                    if (auto m = group.match_free())
+                        free = Reduce::wrap(index + m.lowest(), cap);
+                }
+                if (group.match_empty()) break;  // Key not found
+                // Next group
+                index = Reduce::wrap(index + ProbeGroup::width, cap);
+            }
+            stats.on_probe(groups);
+            if (ctrl[free] == ctrl_deleted) tombstones -= 1;
+            set_ctrl(free, h);
+            return {&slots[free], true};
+        }
+
+        // Place `slot` in the first free position on the probe sequence
+        // for its `hash`. The caller guarantees `slot.key` is absent.
+        void emplace(Slot &&slot, uint64_t hash) {
+            size_t index = Reduce::index(hash, cap);
+            while (true) {
+                auto free = ProbeGroup(&ctrl[index]).match_free();
+                if (free) {
+                    index = Reduce::wrap(index + free.lowest(), cap);
+                    if (ctrl[index] == ctrl_deleted) tombstones -= 1;
+                    set_ctrl(index, ctrl_tag(hash));
+                    slots[index] = std::move(slot);
+                    return;
+                }
+                // Next group
+                index = Reduce::wrap(index + ProbeGroup::width, cap);
+            }
+        }
+
+        // Free `slot`. Its position can go straight back to empty when no
+        // probe could have passed it: i.e. when the run of non-empty bytes
+        // around it is shorter than a group, or one group spans the whole
+        // table. Otherwise leave a tombstone so later keys stay reachable.
+        void erase(Slot *slot) {
+            const size_t index = static_cast<size_t>(slot - slots.data());
+            *slot = Slot{};  // Release what the key and value own
+            bool was_never_full = cap <= ProbeGroup::width;
+            if (!was_never_full) {
+                const size_t before =
+                    Reduce::wrap(index + cap - ProbeGroup::width, cap);
+                auto empty_after = ProbeGroup(&ctrl[index]).match_empty();
+                auto empty_before = ProbeGroup(&ctrl[before]).match_empty();
+                was_never_full =
+                    empty_before && empty_after &&
+                    (empty_after.lowest() + empty_before.leading_zeros()) <
+                        ProbeGroup::width;
+            }
+            if (was_never_full) {
+                set_ctrl(index, ctrl_empty);
+            } else {
+                set_ctrl(index, ctrl_deleted);
+                tombstones += 1;
+            }
+        }
+
+        // Move slot `i` out to `fn`, leaving a tombstone so probe sequences
+        // through it stay intact
+        template <typename Fn>
+        void drain(size_t i, Fn &&fn) {
+            if (!is_full(i)) return;
+            fn(std::move(slots[i]));
+            set_ctrl(i, ctrl_deleted);
+            tombstones += 1;
+        }
+
+        template <typename Fn, typename HashOf>
+        void visit(Fn &&fn, HashOf &&hash_of) const {
+            for (size_t i = 0; i < cap; i++) {
+                if (!is_full(i)) continue;
+                const size_t home = Reduce::index(hash_of(slots[i]), cap);
+                fn(slots[i], i >= home ? i - home : i + cap - home);
+            }
+        }
+
+        const Slot *first(size_t i) const {
+            for (; i < cap; i++)
+                if (is_full(i)) return &slots[i];
+            return nullptr;
+        }
+        const Slot *next(const Slot *slot) const {
+            return first(bucket_of(slot) + 1);
+        }
+        size_t bucket_of(const Slot *slot) const {
+            return static_cast<size_t>(slot - slots.data());
+        }
+
+        void prefetch(uint64_t hash) const {
+            const size_t index = Reduce::index(hash, cap);
+            __builtin_prefetch(&ctrl[index]);
+            __builtin_prefetch(&slots[index]);
+        }
+
+        void add_memory(MemoryUsage &usage) const {
+            usage.ctrl += ctrl.capacity();
+            usage.slots += slots.capacity() * sizeof(Slot);
+        }
+    };
+};
+
+// Robin Hood linear probing: an insert takes the slot of any entry closer to
+// its home than the newcomer is, so probe distances stay even and the worst
+// case short at high load. A lookup stops at the first entry closer to home
+// than itself, so misses end early too. Removal shifts the following run
+// back a slot instead of leaving a tombstone.
+struct RobinHoodProbing {
+    static constexpr double max_load = 0.9;
+
+    template <typename Slot, typename Reduce>
+    struct Table {
+        // Stored distances saturate here; longer ones are recomputed from
+        // the cached hash
+        static constexpr uint8_t dist_max = 255;
+        // An insert can push entries on past any range boundary
+        static constexpr bool parallel_build = false;
+
+        size_t cap = 0;
+        // Deleted slots, only ever left by a resize draining this table (or
+        // a removal while it drains). They keep their distance, so early
+        // miss termination still holds across them.
+        size_t tombstones = 0;
+        std::vector<int8_t> ctrl;   // `ctrl_tag`, `ctrl_empty`, `ctrl_deleted`
+        std::vector<uint8_t> dist;  // Probe distance of each non-empty slot
+        std::vector<Slot> slots;
+
+        Table() = default;
+        Table(size_t n, const RobinHoodProbing &)
+            : cap(n), ctrl(n, ctrl_empty), dist(n, 0), slots(n) {}
+
+        bool is_full(size_t i) const { return ctrl[i] >= 0; }
+
+        // As `GroupProbing`'s; `dist` is only read for non-empty slots, so
+        // it can keep stale values
+        void clear(void) {
+            if constexpr (!std::is_trivially_destructible_v<Slot>) {
+                for (size_t i = 0; i < cap; i++)
+                    if (ctrl[i] != ctrl_empty) slots[i] = Slot{};
+            }
+            std::fill(ctrl.begin(), ctrl.end(), ctrl_empty);
+            tombstones = 0;
+        }
+
+        template <typename Match, typename Stats>
+        Slot *find(uint64_t hash, Match &&match, Stats &stats) {
+            if (cap == 0) return nullptr;
+            const int8_t h = ctrl_tag(hash);
+            size_t i = Reduce::index(hash, cap);
+            for (size_t d = 0; d < cap; d++, i = next(i)) {
+                // A stored distance never exceeds the real one, so the exact
+                // value is only needed when the stored one looks too short
+                if (ctrl[i] == ctrl_empty || (dist[i] < d && distance(i) < d)) {
+                    stats.on_probe(d + 1);
+                    return nullptr;  // Key not found
+                }
+                if (ctrl[i] == h && slots[i].hash == hash &&
+                    match(slots[i].key)) {
+                    stats.on_probe(d + 1);
+                    return &slots[i];
+                }
+            }
+            stats.on_probe(cap);
+            return nullptr;
+        }
+
+        // `find`, except a miss stops where an insert would go: the first
+        // empty slot or richer entry. That entry and the rest of its run are
+        // carried one step on, and the vacated slot claimed and returned
+        // with `true` for the caller to fill.
+        template <typename Match, typename Stats>
+        std::pair<Slot *, bool> find_or_claim(uint64_t hash, Match &&match,
+                                              Stats &stats) {
+            const int8_t h = ctrl_tag(hash);
+            size_t i = Reduce::index(hash, cap);
+            for (size_t d = 0;; d++, i = next(i)) {
+                const bool empty = ctrl[i] == ctrl_empty;
+                if (empty || (dist[i] < d && distance(i) < d)) {
+                    stats.on_probe(d + 1);
+                    if (ctrl[i] == ctrl_deleted) {
+                        tombstones -= 1;
+                    } else if (!empty) {
+                        const size_t di = distance(i);
+                        carry(next(i), di + 1, std::move(slots[i]));
+                    }
+                    ctrl[i] = h;
+                    dist[i] = saturate(d);
+                    return {&slots[i], true};
+                }
+                if (ctrl[i] == h && slots[i].hash == hash &&
+                    match(slots[i].key)) {
+                    stats.on_probe(d + 1);
+                    return {&slots[i], false};
+                }
+            }
+        }
+
+        // The caller guarantees `slot.key` is absent
+        void emplace(Slot &&slot, uint64_t hash) {
+            carry(Reduce::index(hash, cap), 0, std::move(slot));
+        }
+
+        // Shift the run after `slot` back by one until an empty slot or an
+        // entry already at home. A draining table instead leaves a
+        // tombstone, since a shift could carry an entry behind the drain.
+        void erase(Slot *slot) {
+            size_t i = static_cast<size_t>(slot - slots.data());
+            if (tombstones != 0) {
+                const uint64_t hash = slot->hash;
+                *slot = Slot{};  // Release what the key and value own
+                slot->hash = hash;
+                ctrl[i] = ctrl_deleted;
+                tombstones += 1;
+                return;
+            }
+            for (size_t j = next(i); is_full(j); i = j, j = next(j)) {
+                const size_t dj = distance(j);
+                if (dj == 0) break;
+                slots[i] = std::move(slots[j]);
+                ctrl[i] = ctrl[j];
+                dist[i] = saturate(dj - 1);
+            }
+            slots[i] = Slot{};
+            ctrl[i] = ctrl_empty;
+            dist[i] = 0;
+        }
+
+        template <typename Fn>
+        void drain(size_t i, Fn &&fn) {
+            if (!is_full(i)) return;
+            fn(std::move(slots[i]));  // Leaves `hash` for `distance`
+            ctrl[i] = ctrl_deleted;
+            tombstones += 1;
+        }
+
+        template <typename Fn, typename HashOf>
+        void visit(Fn &&fn, HashOf &&) const {
+            for (size_t i = 0; i < cap; i++)
+                if (is_full(i)) fn(slots[i], distance(i));
+        }
+
+        const Slot *first(size_t i) const {
+            for (; i < cap; i++)
+                if (is_full(i)) return &slots[i];
+            return nullptr;
+        }
+        const Slot *next(const Slot *slot) const {
+            return first(bucket_of(slot) + 1);
+        }
+        size_t bucket_of(const Slot *slot) const {
+            return static_cast<size_t>(slot - slots.data());
+        }
+
+        void prefetch(uint64_t hash) const {
+            const size_t index = Reduce::index(hash, cap);
+            __builtin_prefetch(&ctrl[index]);
+            __builtin_prefetch(&dist[index]);
+            __builtin_prefetch(&slots[index]);
+        }
+
+        void add_memory(MemoryUsage &usage) const {
+            usage.ctrl += ctrl.capacity() + dist.capacity();
+            usage.slots += slots.capacity() * sizeof(Slot);
+        }
+
+       private:
+        size_t next(size_t i) const { return Reduce::wrap(i + 1, cap); }
+
+        static uint8_t saturate(size_t d) {
+            return static_cast<uint8_t>(std::min<size_t>(d, dist_max));
+        }
+
+        size_t distance(size_t i) const {
+            if (dist[i] < dist_max) return dist[i];
+            const size_t home = Reduce::index(slots[i].hash, cap);
+            return i >= home ? i - home : i + cap - home;
+        }
+
+        void put(size_t i, Slot &&slot, size_t d) {
+            ctrl[i] = ctrl_tag(slot.hash);
+            dist[i] = saturate(d);
+            slots[i] = std::move(slot);
+        }
+
+        // Insert `slot`, already `d` steps from home, from position `i` on
+        void carry(size_t i, size_t d, Slot &&slot) {
+            Slot cur = std::move(slot);
+            for (;; d++, i = next(i)) {
+                if (ctrl[i] == ctrl_empty) {
+                    put(i, std::move(cur), d);
+                    return;
+                }
+                const size_t di = distance(i);
+                if (di >= d) continue;
+                if (ctrl[i] == ctrl_deleted) {  // Richer, nothing to carry on
+                    tombstones -= 1;
+                    put(i, std::move(cur), d);
+                    return;
+                }
+                // Take the richer entry's slot and carry it on instead
+                std::swap(cur, slots[i]);
+                ctrl[i] = ctrl_tag(slots[i].hash);
+                dist[i] = saturate(d);
+                d = di;
+            }
+        }
+    };
+};
+
+// Separate chaining: each bucket is a singly linked list of nodes taken from
+// a per-table `NodePool`, so inserts don't `malloc` per entry and `clear`
+// keeps the nodes for reuse. Never needs tombstones, and degrades gracefully
+// past a load of 1.
+struct SeparateChaining {
+    static constexpr double max_load = 1.0;
+
+    // Where node slabs come from, e.g. a `std::pmr::monotonic_buffer_resource`
+    // for a table that is built once and dropped whole
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+
+    template <typename Slot, typename Reduce>
+    struct Table {
+        // An entry plus its link, so a `Slot *` from `find` converts back
+        struct Node : Slot {
+            Node *next = nullptr;
+        };
+
+        // The node pool isn't thread-safe
+        static constexpr bool parallel_build = false;
+
+        size_t cap = 0;
+        size_t tombstones = 0;  // Always zero
+        std::vector<Node *> heads;
+        NodePool<Node> pool;
+
+        Table() = default;
+        Table(size_t n, const SeparateChaining &policy)
+            : cap(n), heads(n, nullptr), pool(policy.resource) {}
+
+        void clear(void) {
+            for (size_t i = 0; i < cap; i++) drain(i, [](Slot &&) {});
+        }
+
+        template <typename Match, typename Stats>
+        Slot *find(uint64_t hash, Match &&match, Stats &stats) {
+            if (cap == 0) return nullptr;
+            size_t visited = 1;  // The bucket head
+            for (Node *node = heads[Reduce::index(hash, cap)]; node != nullptr;
+                 node = node->next, visited++) {
+                if (node->hash == hash && match(node->key)) {
+                    stats.on_probe(visited);
+                    return node;
+                }
+            }
+            stats.on_probe(visited);
+            return nullptr;
+        }
+
+        // `find`, pushing a fresh node for the caller to fill on a miss
+        template <typename Match, typename Stats>
+        std::pair<Slot *, bool> find_or_claim(uint64_t hash, Match &&match,
+                                              Stats &stats) {
+            if (Slot *slot = find(hash, match, stats)) return {slot, false};
+            Node *node = pool.make();
+            Node *&head = heads[Reduce::index(hash, cap)];
+            node->next = head;
+            head = node;
+            return {node, true};
+        }
+
+        // Push onto the front of the bucket; the caller guarantees
+        // `slot.key` is absent
+        void emplace(Slot &&slot, uint64_t hash) {
+            Node *node = pool.make();
+            Node *&head = heads[Reduce::index(hash, cap)];
+            static_cast<Slot &>(*node) = std::move(slot);
+            node->next = head;
+            head = node;
+        }
+
+        void erase(Slot *slot) {
+            Node *node = static_cast<Node *>(slot);
+            Node **link = &heads[Reduce::index(slot->hash, cap)];
+            while (*link != node) link = &(*link)->next;
+            *link = node->next;
+            *slot = Slot{};  // Release what the key and value own
+            pool.release(node);
+        }
+
+        // Move every entry of bucket `i` out to `fn` and recycle its nodes
+        template <typename Fn>
+        void drain(size_t i, Fn &&fn) {
+            for (Node *node = heads[i]; node != nullptr;) {
+                Node *next = node->next;
+                Slot &slot = *node;
+                fn(std::move(slot));
+                slot = Slot{};
+                pool.release(node);
+                node = next;
+            }
+            heads[i] = nullptr;
+        }
+
+        // Displacement is the position in the chain
+        template <typename Fn, typename HashOf>
+        void visit(Fn &&fn, HashOf &&) const {
+            for (size_t i = 0; i < cap; i++) {
+                size_t d = 0;
+                for (const Node *node = heads[i]; node != nullptr;
+                     node = node->next)
+                    fn(static_cast<const Slot &>(*node), d++);
+            }
+        }
+
+        const Slot *first(size_t i) const {
+            for (; i < cap; i++)
+                if (heads[i] != nullptr) return heads[i];
+            return nullptr;
+        }
+        const Slot *next(const Slot *slot) const {
+            const Node *node = static_cast<const Node *>(slot);
+            return node->next != nullptr ? node->next
+                                         : first(bucket_of(slot) + 1);
+        }
+        size_t bucket_of(const Slot *slot) const {
+            return Reduce::index(slot->hash, cap);
+        }
+
+        void prefetch(uint64_t hash) const {
+            __builtin_prefetch(&heads[Reduce::index(hash, cap)]);
+        }
+
+        void add_memory(MemoryUsage &usage) const {
+            usage.ctrl += heads.capacity() * sizeof(Node *);
+            usage.nodes += pool.bytes();
+        }
+    };
+};
+
+// Hash table of `K` to `V`, open addressing or chained as `Collision` picks,
+// and bounded as a cache if `Eviction` is `ClockEviction`.
+// Both must be default constructible; the default `Eq` compares
+// `std::string_view` keys by length first.
+template <typename K, typename V, typename Hash = Fnv1aHash,
+          typename Eq = std::equal_to<>, typename Reduce = ModuloReduce,
+          typename Collision = GroupProbing, typename Stats = NoStats,
+          typename Eviction = NoEviction>
+struct HashTable {
+    // Grow once `size / capacity` exceeds this
+    static constexpr double load_capacity_threshold = Collision::max_load;
+    // Buckets moved from the old table to the new one per `insert`/`get`
+    // while a resize is in flight.
+    static constexpr size_t rehash_step = 4;
+    // Keys hashed and prefetched ahead of probing in the batch APIs
+    static constexpr size_t batch_width = 16;
+    // Fewest entries per thread the bulk constructor bothers to spawn for
+    static constexpr size_t bulk_build_grain = 16384;
+
+    using key_type = typename KeyStorage<K>::type;
+
+    template <typename Q>
+    using key_arg = typename KeyArg<is_transparent<Hash>::value &&
+                                    is_transparent<Eq>::value>::
+        template type<Q, key_type>;
+
+    // An entry as stored, and what iterators yield. Open addressing keeps
+    // entries inline in the slot array, so a probe walks contiguous memory
+    // instead of chasing a heap node per slot. The full hash is kept so
+    // probes can reject mismatches with one integer compare before `Eq`, and
+    // rehashing never rereads key memory, unless `Hash` opts out with
+    // `cache_hash = false` to save its 8 bytes: then probes compare the tag
+    // and go to `Eq`, and resizes rehash keys (`GroupProbing` only, since
+    // Robin Hood and chaining read stored hashes as they go).
+    using hash_field =
+        std::conditional_t<caches_hash<Hash>::value, uint64_t, NoCachedHash>;
+    static_assert(caches_hash<Hash>::value ||
+                      std::is_same_v<Collision, GroupProbing>,
+                  "only GroupProbing tables can leave hashes uncached");
+
+    struct Slot {
+        [[no_unique_address]] hash_field hash;
+        key_type key;
+        V val;
+        [[no_unique_address]] typename Eviction::Mark mark = {};
+    };
+
+    struct const_iterator;
+
+    // Capacity is at least one probe group and rounded as `Reduce` requires
+    // (and, with `ClockEviction`, no more than its budget allows)
+    explicit HashTable(size_t capacity, const Hash &hash = Hash(),
+                       const Eq &eq = Eq(),
+                       const Collision &collision = Collision(),
+                       const Eviction &eviction = Eviction())
+        : m_hash(hash),
+          m_eq(eq),
+          m_collision(collision),
+          m_eviction(eviction),
+          m_cap(Reduce::round_capacity(
+              std::max(std::min(capacity, max_capacity()), ProbeGroup::width))),
+          m_table(m_cap, m_collision),
+          m_arena(arena_chunk_size(eviction)) {
+        if constexpr (Eviction::enabled) fit_budget();
+    }
+
+    // Build from `[first, last)`, random access iterators over pairs whose
+    // `first` converts to `key_type` and `second` to `V`, sized once for all
+    // of them. Keys are hashed in parallel and radix-partitioned into one
+    // range of home buckets per thread; with `GroupProbing` each thread then
+    // fills its own range, and the few entries whose probe runs off the end
+    // of their range are inserted afterwards. As with `insert`, a later
+    // duplicate wins. `threads == 0` means one per hardware thread.
+    template <typename It, typename = decltype(std::declval<It>()->second)>
+    HashTable(It first, It last, size_t threads = 0, const Hash &hash = Hash(),
+              const Eq &eq = Eq(), const Collision &collision = Collision())
+        : HashTable(capacity_for(static_cast<size_t>(last - first)), hash, eq,
+                    collision) {
+        bulk_build(first, static_cast<size_t>(last - first), threads);
+    }
+
+    // A moved-from table is left empty at the minimum capacity, so it can
+    // still be used like any other
+    HashTable(HashTable &&other)
+        : HashTable(0, other.m_hash, other.m_eq, other.m_collision,
+                    other.m_eviction) {
+        swap(other);
+    }
+    HashTable &operator=(HashTable &&other) {
+        if (this == &other) return *this;
+        HashTable moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+    ~HashTable() = default;  // The default destructor
+
+    // mutable methods:
+
+    // Clear all entries in hash table, keeping the capacity. Costs a
+    // `memset` of the control bytes (nothing if there's nothing to clear)
+    // plus resetting the slots still holding keys or values that own memory;
+    // `ArenaString` key bytes are dropped in O(arena chunks).
+    void clear(void) {
+        if (m_size != 0 || m_table.tombstones != 0) m_table.clear();
+        m_old_table = Table();  // Abandon any in-flight rehash
+        m_arena.clear();
+        m_rehash_index = 0;
+        m_size = 0;
+        m_key_bytes = 0;
+        m_hand = m_old_hand = 0;
+    }
+
+    // Retrieve the entry value at `key` in hash table
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key) {
+        return this->template get<Q>(key, m_hash(key));
+    }
+
+    // The `get`, `insert` and `remove` overloads taking `hash` skip hashing
+    // `key`, for front-ends that already hashed it; `hash` must equal
+    // `Hash()(key)`.
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key, uint64_t hash) {
+        rehash_step_once();
+        Slot *slot = find(m_table, key, hash);
+        if (slot == nullptr) slot = find(m_old_table, key, hash);
+        if (slot == nullptr) return std::nullopt;  // Key not found
+        touch(*slot);
+        return slot->val;
+    }
+
+    // Insert value `val` in hash table at an index computed via hashing `key`
+    // with `Hash`
+    void insert(key_type key, V val) {
+        const uint64_t hash = m_hash(key);
+        insert(std::move(key), std::move(val), hash);
+    }
+
+    void insert(key_type key, V val, uint64_t hash) {
+        insert_or_assign(std::move(key), std::move(val), hash);
+    }
+
+    // Insert `V(args...)` at `key` unless it's already present, in which
+    // case nothing is constructed. Returns whether it was inserted.
+    template <typename... Args>
+    bool try_emplace(key_type key, Args &&...args) {
+        const uint64_t hash = m_hash(key);
+        return upsert(
+            key, hash, [&](V &val) { val = V(std::forward<Args>(args)...); },
+            [](V &) {});
+    }
+
+    // `insert`, returning whether `key` was new rather than updated
+    bool insert_or_assign(key_type key, V val) {
+        const uint64_t hash = m_hash(key);
+        return insert_or_assign(std::move(key), std::move(val), hash);
+    }
+
+    bool insert_or_assign(key_type key, V val, uint64_t hash) {
+        const auto assign = [&](V &stored) { stored = std::move(val); };
+        return upsert(key, hash, assign, assign);
+    }
+
+    // Call `fn(val)` on the value at `key`, inserting a default `V` first
+    // if it's absent. Returns whether it was inserted.
+    template <typename Fn>
+    bool update(key_type key, Fn &&fn) {
+        const uint64_t hash = m_hash(key);
+        return upsert(
+            key, hash,
+            [&](V &val) {
+                val = V();
+                fn(val);
+            },
+            fn);
+    }
+
+    // Add `delta` to the value at `key` (taken as `V()` if absent) and
+    // return the value before, like `std::atomic::fetch_add`
+    V fetch_add(key_type key, V delta) {
+        const uint64_t hash = m_hash(key);
+        V prev = V();
+        upsert(
+            key, hash,
+            [&](V &val) {
+                val = V();
+                val += delta;
+            },
+            [&](V &val) {
+                prev = val;
+                val += delta;
+            });
+        return prev;
+    }
+
+    // Look up `keys[i]` into `out[i]` for each of the `n` keys. Keys are
+    // hashed and their first probe group prefetched `batch_width` at a
+    // time before any is probed, so the cache misses overlap instead of
+    // stalling one after another.
+    template <typename Q = key_type>
+    void get_batch(const key_arg<Q> *keys, size_t n, std::optional<V> *out) {
+        uint64_t hashes[batch_width];
+        for (size_t base = 0; base < n; base += batch_width) {
+            const size_t count = std::min(batch_width, n - base);
+            for (size_t i = 0; i < count; i++) {
+                hashes[i] = m_hash(keys[base + i]);
+                prefetch(hashes[i]);
+            }
+            for (size_t i = 0; i < count; i++)
+                out[base + i] =
+                    this->template get<Q>(keys[base + i], hashes[i]);
+        }
+    }
+
+    // Insert or update `keys[i]` with `vals[i]` for each of the `n` pairs,
+    // prefetching like `get_batch`
+    void insert_batch(const key_type *keys, const V *vals, size_t n) {
+        uint64_t hashes[batch_width];
+        for (size_t base = 0; base < n; base += batch_width) {
+            const size_t count = std::min(batch_width, n - base);
+            for (size_t i = 0; i < count; i++) {
+                hashes[i] = m_hash(keys[base + i]);
+                prefetch(hashes[i]);
+            }
+            for (size_t i = 0; i < count; i++)
+                insert(keys[base + i], vals[base + i], hashes[i]);
+        }
+    }
+
+    // Pre-size the table so `n` entries fit without crossing the load
+    // threshold. Existing entries move over incrementally as usual.
+    void reserve(size_t n) {
+        const size_t wanted = std::min(capacity_for(n), max_capacity());
+        if (wanted <= m_cap) return;
+        if (m_size == 0) {  // Nothing to move, swap the storage outright
+            m_old_table = Table();
+            m_rehash_index = 0;
+            m_cap = Reduce::round_capacity(wanted);
+            m_table = Table(m_cap, m_collision);
+            return;
+        }
+        rehash_to(Reduce::round_capacity(wanted));
+    }
+
+    // Remove the entry at `key`, returning whether it was present. Removed
+    // `ArenaString` keys' bytes are reclaimed by compacting the arena once
+    // they outweigh the live keys'.
+    template <typename Q = key_type>
+    bool remove(const key_arg<Q> &key) {
+        return this->template remove<Q>(key, m_hash(key));
+    }
+
+    template <typename Q = key_type>
+    bool remove(const key_arg<Q> &key, uint64_t hash) {
+        rehash_step_once();
+        if (auto slot = find(m_table, key, hash)) {
+            m_key_bytes -= key_bytes(slot->key);
+            m_table.erase(slot);
+        } else if (auto old_slot = find(m_old_table, key, hash)) {
+            m_key_bytes -= key_bytes(old_slot->key);
+            m_old_table.erase(old_slot);
+        } else {
+            return false;
+        }
+        m_size -= 1;
+        reclaim_keys();
+        return true;
+    }
+
+    // Call `fn(key, val)` for every entry, walking the slot array in memory
+    // order (the new table, then any old one still draining). `fn` may change
+    // `val` but not add or remove entries.
+    template <typename Fn>
+    void for_each(Fn &&fn) {
+        for (Table *table : {&m_table, &m_old_table})
+            for_each_in(*table, 0, table->cap, fn);
+    }
+
+    // `for_each` split into contiguous bucket ranges over `threads` threads,
+    // for full scans of large tables; `fn` is called concurrently, on
+    // distinct entries
+    template <typename Fn>
+    void parallel_for_each(
+        Fn &&fn, size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<size_t>(threads, 1);
+        std::vector<std::thread> workers;
+        for (Table *table : {&m_table, &m_old_table}) {
+            const size_t per_thread = (table->cap + threads - 1) / threads;
+            for (size_t begin = 0; begin < table->cap; begin += per_thread) {
+                const size_t end = std::min(begin + per_thread, table->cap);
+                workers.emplace_back([&fn, table, begin, end] {
+                    for_each_in(*table, begin, end, fn);
+                });
+            }
+        }
+        for (auto &worker : workers) worker.join();
+    }
+
+    // immutable methods:
+
+    // Forward iterator over entries in `for_each` order. Any call that isn't
+    // `const` may resize and so invalidates it (including `get`, which
+    // advances an in-flight rehash).
+    struct const_iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Slot;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Slot *;
+        using reference = const Slot &;
+
+        reference operator*(void) const { return *m_slot; }
+        pointer operator->(void) const { return m_slot; }
+
+        const_iterator &operator++(void) {
+            m_slot = table().next(m_slot);
+            settle();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+
+        bool operator==(const const_iterator &other) const {
+            return m_slot == other.m_slot;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return m_slot != other.m_slot;
+        }
+
+       private:
+        friend struct HashTable;
+
+        const_iterator(const HashTable *owner, bool in_old, const Slot *slot)
+            : m_owner(owner), m_in_old(in_old), m_slot(slot) {
+            settle();
+        }
+
+        const auto &table(void) const {
+            return m_in_old ? m_owner->m_old_table : m_owner->m_table;
+        }
+        // Past the new table's last entry, move on to the old table's first
+        void settle(void) {
+            if (m_slot != nullptr || m_in_old) return;
+            m_in_old = true;
+            m_slot = m_owner->m_old_table.first(0);
+        }
+
+        const HashTable *m_owner;
+        bool m_in_old;
+        const Slot *m_slot;  // Null at the end
+    };
+
+    const_iterator begin(void) const {
+        return const_iterator(this, false, m_table.first(0));
+    }
+    const_iterator end(void) const {
+        return const_iterator(this, true, nullptr);
+    }
+
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        for (const Table *table : {&m_table, &m_old_table})
+            for_each_in(*table, 0, table->cap, fn);
+    }
+
+    size_t capacity(void) const { return m_cap; }
+
+    // Check for the existence of a key without retrieving its value
+    template <typename Q = key_type>
+    bool contains(const key_arg<Q> &key) {
+        return this->template get<Q>(key).has_value();
+    }
+
+    // Check if the hash table is empty
+    bool is_empty(void) const { return m_size == 0; }
+
+    // Return count of entries in hash table
+    size_t size(void) const { return m_size; }
+
+    // Check whether entries are still being moved out of a smaller table
+    bool is_rehashing(void) const { return m_old_table.cap != 0; }
+
+    // Write every entry to `path` as a snapshot `MappedHashTable` can map
+    // back (see `SnapshotHeader`), laid out afresh at the current capacity so
+    // tombstones and an in-flight resize are dropped. Returns false on I/O
+    // failure. Values must be trivially copyable, keys too unless strings.
+    bool save(const char *path) const {
+        using Key = SnapshotKey<key_type>;
+        using DiskSlot = SnapshotSlot<key_type, V>;
+        const auto align = [](uint64_t n) { return (n + 63) & ~uint64_t{63}; };
+
+        std::vector<int8_t> ctrl(m_cap + snapshot_mirror, ctrl_empty);
+        std::vector<DiskSlot> slots(m_cap);
+        std::string keys;
+        // A fresh layout has no tombstones, so each entry just takes the
+        // first empty slot from its home index
+        const auto place = [&](const Slot &slot, size_t) {
+            const uint64_t hash = hash_of(slot);
+            size_t i = Reduce::index(hash, m_cap);
+            while (ctrl[i] != ctrl_empty) i = Reduce::wrap(i + 1, m_cap);
+            for (size_t j = i; j < ctrl.size(); j += m_cap)
+                ctrl[j] = ctrl_tag(hash);
+            slots[i].hash = hash;
+            slots[i].key = Key::store(slot.key, keys);
+            slots[i].val = slot.val;
+        };
+        const auto rehash = [&](const Slot &slot) { return hash_of(slot); };
+        m_table.visit(place, rehash);
+        m_old_table.visit(place, rehash);
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+        header.cap = m_cap;
+        header.size = m_size;
+        header.slot_size = sizeof(DiskSlot);
+        header.hash_check = m_hash(key_type{});
+        header.reduce_check = reduce_check<Reduce>(m_cap);
+        header.ctrl_offset = align(sizeof(header));
+        header.slots_offset = align(header.ctrl_offset + ctrl.size());
+        header.keys_offset =
+            align(header.slots_offset + m_cap * sizeof(DiskSlot));
+        header.keys_size = keys.size();
+
+        FILE *file = std::fopen(path, "wb");
+        if (file == nullptr) return false;
+        uint64_t at = 0;
+        const auto write_at = [&](uint64_t offset, const void *data, size_t n) {
+            static const char zeros[64] = {};
+            bool ok = std::fwrite(zeros, 1, offset - at, file) == offset - at;
+            ok = ok && std::fwrite(data, 1, n, file) == n;
+            at = offset + n;
+            return ok;
+        };
+        bool ok = write_at(0, &header, sizeof(header)) &&
+                  write_at(header.ctrl_offset, ctrl.data(), ctrl.size()) &&
+                  write_at(header.slots_offset, slots.data(),
+                           slots.size() * sizeof(DiskSlot)) &&
+                  write_at(header.keys_offset, keys.data(), keys.size());
+        ok = (std::fclose(file) == 0) && ok;
+        return ok;
+    }
+
+    // Occupancy and probe statistics; scans every slot, so O(capacity)
+    TableStats stats(void) const {
+        TableStats st;
+        st.size = m_size;
+        st.capacity = m_cap + m_old_table.cap;
+        st.tombstones = m_table.tombstones;
+        st.load_factor = static_cast<double>(m_size) / st.capacity;
+        size_t total = 0;
+        for (const Table *table : {&m_table, &m_old_table}) {
+            table->visit(
+                [&](const Slot &, size_t d) {
+                    st.max_displacement = std::max(st.max_displacement, d);
+                    total += d;
+                },
+                [&](const Slot &slot) { return hash_of(slot); });
+        }
+        if (m_size != 0)
+            st.mean_displacement = static_cast<double>(total) / m_size;
+        if constexpr (Stats::enabled) {
+            st.probe_histogram.assign(std::begin(m_stats.probes),
+                                      std::end(m_stats.probes));
+            st.probe_groups = m_stats.probe_groups;
+            st.resizes = m_stats.resizes;
+            st.rehash_seconds =
+                std::chrono::duration<double>(m_stats.rehash_time).count();
+        }
+        return st;
+    }
+
+    // Bytes allocated for both tables and the key arena, by component
+    MemoryUsage memory_usage(void) const {
+        MemoryUsage usage;
+        usage.object = sizeof(*this);
+        m_table.add_memory(usage);
+        m_old_table.add_memory(usage);
+        usage.arena = m_arena.allocated();
+        return usage;
+    }
+
+   private:
+    // data structures:
+
+    using Table = typename Collision::template Table<Slot, Reduce>;
+
+    // Capacity that holds `n` entries without crossing the load threshold
+    static size_t capacity_for(size_t n) {
+        return static_cast<size_t>(static_cast<double>(n) /
+                                   load_capacity_threshold) + 1;
+    }
+
+    void swap(HashTable &other) {
+        using std::swap;
+        swap(m_hash, other.m_hash);
+        swap(m_eq, other.m_eq);
+        swap(m_collision, other.m_collision);
+        swap(m_eviction, other.m_eviction);
+        swap(m_cap, other.m_cap);
+        swap(m_size, other.m_size);
+        swap(m_rehash_index, other.m_rehash_index);
+        swap(m_table, other.m_table);
+        swap(m_old_table, other.m_old_table);
+        swap(m_arena, other.m_arena);
+        swap(m_key_bytes, other.m_key_bytes);
+        swap(m_hand, other.m_hand);
+        swap(m_old_hand, other.m_old_hand);
+        swap(m_stats, other.m_stats);
+    }
+
+    // Run `fn(0)` ... `fn(count - 1)` on a thread each
+    template <typename Fn>
+    static void run_threads(size_t count, Fn &&fn) {
+        if (count == 1) return fn(0);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < count; t++) workers.emplace_back(fn, t);
+        for (auto &worker : workers) worker.join();
+    }
+
+    // The bulk constructor's work on the freshly sized (empty) table
+    template <typename It>
+    void bulk_build(It first, size_t n, size_t threads) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, std::max<size_t>(1, n / bulk_build_grain));
+        const size_t per_thread = (n + threads - 1) / threads;
+        const size_t parts = threads;  // One bucket range per thread
+        const auto part_of = [&](uint64_t hash) {
+            return Reduce::index(hash, m_cap) * parts / m_cap;
+        };
+        const auto chunk = [&](size_t t) {
+            const size_t begin = std::min(n, t * per_thread);
+            return std::make_pair(begin, std::min(n, begin + per_thread));
+        };
+
+        // Hash, and count each thread's chunk of input per partition
+        std::vector<uint64_t> hashes(n);
+        std::vector<size_t> counts(threads * parts);
+        run_threads(threads, [&](size_t t) {
+            const auto [begin, end] = chunk(t);
+            for (size_t i = begin; i < end; i++) {
+                hashes[i] = m_hash(key_type(first[i].first));
+                counts[t * parts + part_of(hashes[i])] += 1;
+            }
+        });
+        // Scatter input positions partition by partition, keeping input
+        // order within each, so duplicates resolve as they would by `insert`
+        std::vector<size_t> offsets(threads * parts);
+        std::vector<size_t> part_begin(parts + 1);
+        for (size_t p = 0, sum = 0; p < parts; p++) {
+            part_begin[p] = sum;
+            for (size_t t = 0; t < threads; t++) {
+                offsets[t * parts + p] = sum;
+                sum += counts[t * parts + p];
+            }
+        }
+        part_begin[parts] = n;
+        std::vector<size_t> order(n);
+        run_threads(threads, [&](size_t t) {
+            const auto [begin, end] = chunk(t);
+            for (size_t i = begin; i < end; i++)
+                order[offsets[t * parts + part_of(hashes[i])]++] = i;
+        });
+
+        if constexpr (Table::parallel_build) {
+            std::vector<std::vector<size_t>> overflow(parts);
+            std::vector<size_t> added(parts);
+            std::vector<size_t> added_bytes(parts);
+            std::vector<StringArena> arenas(parts);
+            run_threads(parts, [&](size_t p) {
+                // First bucket of the next partition, inverting `part_of`
+                const size_t end_bucket = ((p + 1) * m_cap + parts - 1) / parts;
+                for (size_t k = part_begin[p]; k < part_begin[p + 1]; k++) {
+                    const size_t i = order[k];
+                    key_type key(first[i].first);
+                    auto [slot, inserted] = m_table.claim_before(
+                        hashes[i], end_bucket, [&](const key_type &stored) {
+                            return m_eq(stored, key);
+                        });
+                    if (slot == nullptr) {
+                        overflow[p].push_back(i);
+                        continue;
+                    }
+                    if (inserted) {
+                        if constexpr (KeyStorage<K>::owns_bytes)
+                            key = arenas[p].store(key);
+                        slot->hash = hashes[i];
+                        slot->key = std::move(key);
+                        added[p] += 1;
+                        added_bytes[p] += key_bytes(slot->key);
+                    }
+                    slot->val = V(first[i].second);
+                }
+            });
+            for (size_t p = 0; p < parts; p++) {
+                m_size += added[p];
+                m_key_bytes += added_bytes[p];
+                m_arena.adopt(std::move(arenas[p]));
+            }
+            for (const auto &spilled : overflow)
+                for (const size_t i : spilled)
+                    insert(key_type(first[i].first), V(first[i].second),
+                           hashes[i]);
+        } else {
+            for (const size_t i : order)
+                insert(key_type(first[i].first), V(first[i].second), hashes[i]);
+        }
+    }
+
+    // Call `fn(key, val)` for the entries of buckets `[begin, end)`, with
+    // `val` as mutable as `table`
+    template <typename T, typename Fn>
+    static void for_each_in(T &table, size_t begin, size_t end, Fn &fn) {
+        for (const Slot *slot = table.first(begin);
+             slot != nullptr && table.bucket_of(slot) < end;
+             slot = table.next(slot)) {
+            if constexpr (std::is_const_v<T>) {
+                fn(slot->key, slot->val);
+            } else {
+                Slot &entry = const_cast<Slot &>(*slot);
+                fn(static_cast<const key_type &>(entry.key), entry.val);
+            }
+        }
+    }
+
+    // The insert family's one probe: `found(val)` updates an existing
+    // entry, else `make(val)` fills the slot claimed for `key` (stored in
+    // the arena only now it's known to be new). Returns whether it was new.
+    template <typename Make, typename Found>
+    bool upsert(key_type &key, uint64_t hash, Make &&make, Found &&found) {
+        rehash_step_once();
+        if (auto slot = find(m_old_table, key, hash)) {
+            touch(*slot);
+            found(slot->val);  // Not migrated yet
+            return false;
+        }
+        auto [slot, fresh] = m_table.find_or_claim(
+            hash, [&](const key_type &k) { return m_eq(k, key); }, m_stats);
+        if (!fresh) {
+            touch(*slot);
+            found(slot->val);
+            return false;
+        }
+        if constexpr (KeyStorage<K>::owns_bytes) key = m_arena.store(key);
+        slot->hash = hash;
+        slot->key = std::move(key);
+        make(slot->val);
+        touch(*slot);
+        m_size += 1;
+        m_key_bytes += key_bytes(slot->key);
+        if constexpr (Eviction::enabled) {
+            // Spare the new entry, or a tight budget would evict each insert
+            const key_type placed = slot->key;
+            while (m_size > 1 && over_budget()) evict_one(placed);
+            // Evicted keys' bytes stay in the arena until it's rebuilt
+            if (m_arena.allocated() > key_reserve()) compact_keys();
+        }
+        // Tombstones lengthen probes like live entries, so count them too
+        const size_t used = m_size + m_table.tombstones;
+        if (static_cast<double>(used) / m_cap > load_capacity_threshold)
+            grow();
+        return true;
+    }
+
+    // Full hash of a stored entry, recomputed if the slot doesn't keep it
+    uint64_t hash_of(const Slot &slot) const {
+        if constexpr (caches_hash<Hash>::value) return slot.hash;
+        return m_hash(slot.key);
+    }
+
+    // Key bytes `slot.key` holds in the arena
+    static size_t key_bytes(const key_type &key) {
+        if constexpr (KeyStorage<K>::owns_bytes) return key.size();
+        (void)key;
+        return 0;
+    }
+
+    // Most slots the table may double to: `max_entries` at half the load
+    // threshold, leaving the rest for the tombstones evictions leave
+    size_t max_capacity(void) const {
+        if constexpr (Eviction::enabled) {
+            const size_t n = m_eviction.max_entries;
+            if (n < SIZE_MAX / 4)
+                return Reduce::round_capacity(
+                    std::max(capacity_for(2 * n), ProbeGroup::width));
+        }
+        return SIZE_MAX;
+    }
+
+    // Key arena chunks small enough for a tight byte budget to be met
+    static size_t arena_chunk_size(const Eviction &eviction) {
+        if constexpr (Eviction::enabled)
+            return std::clamp(eviction.max_bytes / 16, size_t{4096},
+                              StringArena::default_chunk_size);
+        (void)eviction;
+        return StringArena::default_chunk_size;
+    }
+
+    // Slot, control and node bytes of the current table, as `memory_usage`
+    // counts them
+    size_t table_bytes(void) const {
+        MemoryUsage usage;
+        m_table.add_memory(usage);
+        return usage.total();
+    }
+
+    // Arena bytes the byte budget holds for keys: the live ones, half again
+    // for evicted ones awaiting compaction, and the chunk being filled
+    size_t key_reserve(void) const {
+        if (!KeyStorage<K>::owns_bytes) return 0;
+        return m_key_bytes + m_key_bytes / 2 + m_arena.chunk_size();
+    }
+
+    // Whether the table may double and keep to the eviction budget, with
+    // room for rehashing the doubled table
+    bool may_double(void) const {
+        if constexpr (Eviction::enabled)
+            return m_cap < max_capacity() &&
+                   4 * table_bytes() + key_reserve() <= m_eviction.max_bytes;
+        return true;
+    }
+
+    // Whether the entries break the eviction budget. A table that may not
+    // double also keeps to half its load threshold, so a rehash in place
+    // clears enough tombstones to last. Twice the table is counted, for the
+    // old copy a rehash holds.
+    bool over_budget(void) const {
+        if (m_size > m_eviction.max_entries) return true;
+        if (static_cast<double>(m_size) / m_cap > load_capacity_threshold / 2 &&
+            !may_double())
+            return true;
+        return 2 * table_bytes() + key_reserve() > m_eviction.max_bytes;
+    }
+
+    // Shrink the freshly built table until it keeps to the eviction budget,
+    // throwing `std::invalid_argument` if even the smallest one can't
+    void fit_budget(void) {
+        const size_t min_cap = Reduce::round_capacity(ProbeGroup::width);
+        const auto fits = [&] {
+            return 2 * table_bytes() + key_reserve() <= m_eviction.max_bytes;
+        };
+        while (!fits() && m_cap > min_cap) {
+            m_cap = Reduce::round_capacity(std::max(m_cap / 2, min_cap));
+            m_table = Table(m_cap, m_collision);
+        }
+        if (m_eviction.max_entries == 0 || !fits())
+            throw std::invalid_argument(
+                "eviction budget too small for an empty table");
+    }
+
+    // Note a hit for the eviction policy
+    static void touch(Slot &slot) {
+        if constexpr (Eviction::enabled) slot.mark.referenced = true;
+        (void)slot;
+    }
+
+    // Advance the clock hand to the first unreferenced entry other than
+    // `spare` (which an insert just placed in the new table) and evict it.
+    // While a resize drains the old table, its entries not yet moved are
+    // swept first, since they are the ones a resize would otherwise copy.
+    // Needs an entry besides `spare`.
+    void evict_one(const key_type &spare) {
+        if (is_rehashing() &&
+            evict_from(m_old_table, m_old_hand, m_rehash_index, spare))
+            return;
+        evict_from(m_table, m_hand, 0, spare);
+    }
+
+    // `evict_one` over the entries of `table` in buckets from `begin` on;
+    // returns false if there are none
+    bool evict_from(Table &table, size_t &hand, size_t begin,
+                    const key_type &spare) {
+        if (table.first(begin) == nullptr) return false;
+        const Slot *slot = table.first(std::max(hand, begin));
+        // At most two laps: the first clears every bit
+        for (;; slot = table.next(slot)) {
+            if (slot == nullptr) slot = table.first(begin);  // Wrap around
+            Slot &entry = const_cast<Slot &>(*slot);
+            if (m_eq(entry.key, spare)) continue;
+            if (!entry.mark.referenced) break;
+            entry.mark.referenced = false;  // Second chance
+        }
+        hand = table.bucket_of(slot);
+        m_key_bytes -= key_bytes(slot->key);
+        table.erase(const_cast<Slot *>(slot));
+        m_size -= 1;
+        return true;
+    }
+
+    // Compact the arena once removed keys' bytes outgrow the live ones' by
+    // a chunk, so churn keeps it within about twice the live bytes at a
+    // cost amortized over the removes that freed them
+    void reclaim_keys(void) {
+        if constexpr (KeyStorage<K>::owns_bytes)
+            if (m_arena.bytes() - m_key_bytes >
+                m_key_bytes + m_arena.chunk_size())
+                compact_keys();
+    }
+
+    // Copy the live keys into a fresh arena, dropping removed ones' bytes
+    void compact_keys(void) {
+        if constexpr (KeyStorage<K>::owns_bytes) {
+            StringArena arena(m_arena.chunk_size());
+            for (Table *table : {&m_table, &m_old_table})
+                for (const Slot *slot = table->first(0); slot != nullptr;
+                     slot = table->next(slot))
+                    const_cast<Slot *>(slot)->key = arena.store(slot->key);
+            m_arena = std::move(arena);
+        }
+    }
+
+    template <typename Q>
+    Slot *find(Table &table, const Q &key, uint64_t hash) const {
+        return table.find(
+            hash, [&](const key_type &k) { return m_eq(k, key); }, m_stats);
+    }
+
+    // The new table doubles unless tombstones rather than live entries
+    // filled this one, or the eviction budget caps it, in which case it
+    // keeps the capacity and the rehash just drops them.
+    void grow(void) {
+        if (static_cast<double>(m_size) / m_cap > load_capacity_threshold / 2 &&
+            may_double())
+            rehash_to(Reduce::round_capacity(
+                std::min(m_cap * 2, max_capacity())));
+        else
+            rehash_to(m_cap);
+    }
+
+    // Pull the control bytes and slot where the probe for `hash` starts into
+    // cache. Only a hint: a resize in between just wastes it.
+    void prefetch(uint64_t hash) const { m_table.prefetch(hash); }
+
+    // Start a resize: the current table becomes the old table, and later
+    // calls move `rehash_step` of its buckets at a time into a new one of
+    // `new_cap` slots, so no single call pays for the whole rehash.
+    void rehash_to(size_t new_cap) {
+        while (is_rehashing()) rehash_step_once();  // Finish any prior resize
+        m_stats.on_resize();
+        m_old_table = std::move(m_table);
+        m_cap = new_cap;
+        m_table = Table(m_cap, m_collision);
+        m_rehash_index = 0;
+        m_old_hand = std::exchange(m_hand, 0);  // It stays with its entries
+    }
+
+    // Move the next few old buckets into the new table, skipping tombstones.
+    // Each moved slot becomes a tombstone, so probe sequences for keys not yet
+    // moved stay intact and every key lives in exactly one table.
+    void rehash_step_once(void) {
+        if (!is_rehashing()) return;
+        std::chrono::steady_clock::time_point start;
+        if constexpr (Stats::enabled) start = std::chrono::steady_clock::now();
+        const size_t end = std::min(m_rehash_index + rehash_step,
+                                    m_old_table.cap);
+        for (; m_rehash_index < end; m_rehash_index++)
+            m_old_table.drain(m_rehash_index,
+                              [&](Slot &&slot) {
+                                  const uint64_t hash = hash_of(slot);
+                                  m_table.emplace(std::move(slot), hash);
+                              });
+        if (m_rehash_index == m_old_table.cap) {
+            m_old_table = Table();  // Release the old table
+            m_rehash_index = 0;
+        }
+        if constexpr (Stats::enabled)
+            m_stats.on_rehash(std::chrono::steady_clock::now() - start);
+    }
+
+    // members:
+
+    Hash m_hash;
+    Eq m_eq;
+    Collision m_collision;
+    Eviction m_eviction;
+    size_t m_cap;
+    size_t m_size = 0;  // Entries across both tables, like Python `__m_size`
+    size_t m_rehash_index = 0;  // Next old bucket to move
+
+    Table m_table;
+    Table m_old_table;  // Empty (`cap == 0`) unless a resize is in flight
+
+    StringArena m_arena;  // Key bytes, used only for `ArenaString` keys
+    size_t m_key_bytes = 0;  // Of those, held by live entries
+    size_t m_hand = 0;  // Clock hand: the bucket eviction resumes from
+    size_t m_old_hand = 0;  // Same, in the old table
+    mutable Stats m_stats;  // Updated by `const` probes too
+};
+
+#if __has_include(<sys/mman.h>)
+// Read-only `HashTable` over a snapshot file from `HashTable::save`, mapped
+// with `mmap` instead of loaded: opening costs O(1) whatever the size, pages
+// fault in as lookups touch them, and processes mapping the same file share
+// one copy in the page cache. `K`, `V`, `Hash` and `Reduce` must match the
+// saving table's (`open` rejects a mismatch it can detect).
+template <typename K, typename V, typename Hash = Fnv1aHash,
+          typename Eq = std::equal_to<>, typename Reduce = ModuloReduce>
+struct MappedHashTable {
+    using key_type = typename KeyStorage<K>::type;
+
+    template <typename Q>
+    using key_arg = typename KeyArg<is_transparent<Hash>::value &&
+                                    is_transparent<Eq>::value>::
+        template type<Q, key_type>;
+
+    explicit MappedHashTable(const Hash &hash = Hash(), const Eq &eq = Eq())
+        : m_hash(hash), m_eq(eq) {}
+
+    MappedHashTable(MappedHashTable &&other) noexcept {
+        *this = std::move(other);
+    }
+    MappedHashTable &operator=(MappedHashTable &&other) noexcept {
+        if (this == &other) return *this;
+        close();
+        m_hash = other.m_hash;
+        m_eq = other.m_eq;
+        m_map = std::exchange(other.m_map, nullptr);
+        m_map_size = std::exchange(other.m_map_size, 0);
+        m_header = std::exchange(other.m_header, nullptr);
+        m_ctrl = other.m_ctrl;
+        m_slots = other.m_slots;
+        m_keys = other.m_keys;
+        return *this;
+    }
+    ~MappedHashTable() { close(); }
+
+    // mutable methods:
+
+    // Map the snapshot at `path`, replacing any mapped before. Returns false,
+    // leaving the table empty, if the file is missing or doesn't match.
+    bool open(const char *path) {
+        close();
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 &&
+            static_cast<size_t>(st.st_size) >= sizeof(SnapshotHeader))
+            map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                         MAP_SHARED, fd, 0);
+        ::close(fd);  // The mapping holds its own reference
+        if (map == MAP_FAILED) return false;
+        m_map = map;
+        m_map_size = static_cast<size_t>(st.st_size);
+
+        const auto *base = static_cast<const char *>(map);
+        const auto *header = reinterpret_cast<const SnapshotHeader *>(base);
+        const uint64_t slots_end =
+            header->slots_offset + header->cap * sizeof(DiskSlot);
+        const bool valid =
+            std::memcmp(header->magic, snapshot_magic,
+                        sizeof(snapshot_magic)) == 0 &&
+            header->slot_size == sizeof(DiskSlot) &&
+            header->hash_check == m_hash(key_type{}) &&
+            header->cap >= ProbeGroup::width &&
+            Reduce::round_capacity(header->cap) == header->cap &&
+            header->reduce_check == reduce_check<Reduce>(header->cap) &&
+            header->ctrl_offset + header->cap + snapshot_mirror <=
+                header->slots_offset &&
+            slots_end <= header->keys_offset &&
+            header->keys_offset + header->keys_size <= m_map_size;
+        if (!valid) {
+            close();
+            return false;
+        }
+        m_header = header;
+        m_ctrl = reinterpret_cast<const int8_t *>(base + header->ctrl_offset);
+        m_slots =
+            reinterpret_cast<const DiskSlot *>(base + header->slots_offset);
+        m_keys = base + header->keys_offset;
+        return true;
+    }
+
+    // Unmap the snapshot
+    void close(void) {
+        if (m_map != nullptr) ::munmap(m_map, m_map_size);
+        m_map = nullptr;
+        m_map_size = 0;
+        m_header = nullptr;
+    }
+
+    // immutable methods:
+
+    // Retrieve the entry value at `key`, probing the mapped control bytes the
+    // way `GroupProbing` does
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key) const {
+        if (m_header == nullptr) return std::nullopt;
+        const uint64_t hash = m_hash(key);
+        const int8_t h = ctrl_tag(hash);
+        const size_t cap = capacity();
+        size_t index = Reduce::index(hash, cap);
+        for (size_t seen = 0; seen < cap; seen += ProbeGroup::width) {
+            ProbeGroup group(&m_ctrl[index]);
+            for (auto match = group.match(h); match; match.clear_lowest()) {
+                const DiskSlot &slot =
+                    m_slots[Reduce::wrap(index + match.lowest(), cap)];
+                if (slot.hash == hash && m_eq(Key::load(slot.key, m_keys), key))
+                    return slot.val;
+            }
+            if (group.match_empty()) break;  // Key not found
+            // Next group
+            index = Reduce::wrap(index + ProbeGroup::width, cap);
+        }
+        return std::nullopt;
+    }
+
+    // Check for the existence of a key without retrieving its value
+    template <typename Q = key_type>
+    bool contains(const key_arg<Q> &key) const {
+        return this->template get<Q>(key).has_value();
+    }
+
+    size_t capacity(void) const { return m_header ? m_header->cap : 0; }
+
+    bool is_empty(void) const { return size() == 0; }
+
+    size_t size(void) const { return m_header ? m_header->size : 0; }
+
+   private:
+    using Key = SnapshotKey<key_type>;
+    using DiskSlot = SnapshotSlot<key_type, V>;
+
+    Hash m_hash;
+    Eq m_eq;
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+    const SnapshotHeader *m_header = nullptr;  // Null unless open
+    const int8_t *m_ctrl = nullptr;
+    const DiskSlot *m_slots = nullptr;
+    const char *m_keys = nullptr;
+};
+#endif
+
+// `shard_count` independent `HashTable`s behind one interface, routed by the
+// high hash bits (`hash_partition`) while each shard indexes with the low
+// ones. Every shard grows and rehashes on its own, so one shard's resize
+// never stalls the rest; `shard(i)` exposes them so callers can hand each
+// shard to one worker thread (or NUMA node). Not synchronized itself.
+template <typename K, typename V, typename Hash = Fnv1aHash,
+          typename Eq = std::equal_to<>, typename Reduce = ModuloReduce>
+struct ShardedHashTable {
+    using Shard = HashTable<K, V, Hash, Eq, Reduce>;
+    using key_type = typename Shard::key_type;
+
+    template <typename Q>
+    using key_arg = typename Shard::template key_arg<Q>;
+
+    static_assert(!std::is_same_v<Reduce, FastrangeReduce>,
+                  "fastrange indexes with the same high bits that route keys");
+
+    static constexpr size_t default_shard_count = 16;
+
+    // `capacity` is spread over `shards`, rounded up to a power of two
+    explicit ShardedHashTable(size_t capacity,
+                              size_t shards = default_shard_count,
+                              const Hash &hash = Hash(), const Eq &eq = Eq())
+        : m_hash(hash) {
+        while ((size_t{1} << m_shard_bits) < shards) m_shard_bits += 1;
+        m_shards.reserve(shard_count());
+        for (size_t i = 0; i < shard_count(); i++)
+            m_shards.emplace_back(capacity / shard_count() + 1, hash, eq);
+    }
+
+    // mutable methods:
+
+    void clear(void) {
+        for (auto &shard : m_shards) shard.clear();
+    }
+
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key) {
+        const uint64_t hash = m_hash(key);
+        return m_shards[hash_partition(hash, m_shard_bits)]
+            .template get<Q>(key, hash);
+    }
+
+    void insert(key_type key, V val) {
+        const uint64_t hash = m_hash(key);
+        m_shards[hash_partition(hash, m_shard_bits)].insert(
+            std::move(key), std::move(val), hash);
+    }
+
+    template <typename Q = key_type>
+    bool remove(const key_arg<Q> &key) {
+        const uint64_t hash = m_hash(key);
+        return m_shards[hash_partition(hash, m_shard_bits)]
+            .template remove<Q>(key, hash);
+    }
+
+    // Pre-size every shard for an even share of `n` entries
+    void reserve(size_t n) {
+        for (auto &shard : m_shards) shard.reserve(n / shard_count() + 1);
+    }
+
+    Shard &shard(size_t i) { return m_shards[i]; }
+
+    // immutable methods:
+
+    size_t capacity(void) const {
+        size_t cap = 0;
+        for (const auto &shard : m_shards) cap += shard.capacity();
+        return cap;
+    }
+
+    template <typename Q = key_type>
+    bool contains(const key_arg<Q> &key) {
+        return this->template get<Q>(key).has_value();
+    }
+
+    bool is_empty(void) const { return size() == 0; }
+
+    size_t size(void) const {
+        size_t count = 0;
+        for (const auto &shard : m_shards) count += shard.size();
+        return count;
+    }
+
+    size_t shard_count(void) const { return size_t{1} << m_shard_bits; }
+
+    // Which shard `key` lives in
+    template <typename Q = key_type>
+    size_t shard_index(const key_arg<Q> &key) const {
+        return hash_partition(m_hash(key), m_shard_bits);
+    }
+
+    const Shard &shard(size_t i) const { return m_shards[i]; }
+
+    MemoryUsage memory_usage(void) const {
+        MemoryUsage usage;
+        usage.object = sizeof(*this);
+        for (const auto &shard : m_shards) usage += shard.memory_usage();
+        return usage;
+    }
+
+   private:
+    Hash m_hash;
+    unsigned m_shard_bits = 0;
+    std::vector<Shard> m_shards;
+};
+
+// Up to `N` entries kept inline in the object, with their tags matched a
+// `ProbeGroup` at a time, so a table that stays small never touches the heap.
+// The insert that would make it `N + 1` moves every entry (with its cached
+// hash) into a heap `HashTable`, used from then on until `clear`. Keys are
+// stored as given, so `K` can't be `ArenaString`.
+template <typename K, typename V, size_t N = 16, typename Hash = Fnv1aHash,
+          typename Eq = std::equal_to<>, typename Reduce = ModuloReduce,
+          typename Collision = GroupProbing>
+struct SmallHashTable {
+    using Large = HashTable<K, V, Hash, Eq, Reduce, Collision>;
+    using key_type = typename Large::key_type;
+
+    template <typename Q>
+    using key_arg = typename Large::template key_arg<Q>;
+
+    static_assert(N > 0, "a small table needs at least one inline slot");
+    static_assert(!KeyStorage<K>::owns_bytes,
+                  "inline keys aren't copied into an arena");
+
+    static constexpr size_t inline_capacity = N;
+
+    // `capacity` sizes the heap table, should the entries spill over
+    explicit SmallHashTable(size_t capacity = 0, const Hash &hash = Hash(),
+                            const Eq &eq = Eq())
+        : m_hash(hash), m_eq(eq), m_spill_capacity(capacity) {
+        std::fill(std::begin(m_tags), std::end(m_tags), ctrl_empty);
+    }
+
+    // mutable methods:
+
+    // Clear all entries, going back to inline storage
+    void clear(void) {
+        m_large.reset();
+        for (size_t i = 0; i < m_count; i++) m_slots[i] = Slot{};
+        std::fill(m_tags, m_tags + m_count, ctrl_empty);
+        m_count = 0;
+    }
+
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key) {
+        const uint64_t hash = m_hash(key);
+        if (m_large) return m_large->template get<Q>(key, hash);
+        const size_t i = find(key, hash);
+        if (i == N) return std::nullopt;  // Key not found
+        return m_slots[i].val;
+    }
+
+    void insert(key_type key, V val) {
+        const uint64_t hash = m_hash(key);
+        if (!m_large) {
+            const size_t i = find(key, hash);
+            if (i != N) {
+                m_slots[i].val = std::move(val);  // Update success
+                return;
+            }
+            if (m_count < N) {
+                m_tags[m_count] = ctrl_tag(hash);
+                m_slots[m_count] = Slot{hash, std::move(key), std::move(val)};
+                m_count += 1;  // Insert success
+                return;
+            }
+            spill();
+        }
+        m_large->insert(std::move(key), std::move(val), hash);
+    }
+
+    // Remove the entry at `key`, moving the last inline entry into its place
+    template <typename Q = key_type>
+    bool remove(const key_arg<Q> &key) {
+        const uint64_t hash = m_hash(key);
+        if (m_large) return m_large->template remove<Q>(key, hash);
+        const size_t i = find(key, hash);
+        if (i == N) return false;
+        const size_t last = m_count - 1;
+        m_slots[i] = std::move(m_slots[last]);
+        m_tags[i] = m_tags[last];
+        m_slots[last] = Slot{};  // Release what the key and value own
+        m_tags[last] = ctrl_empty;
+        m_count = last;
+        return true;
+    }
+
+    // Call `fn(key, val)` for every entry, as `HashTable::for_each` does
+    template <typename Fn>
+    void for_each(Fn &&fn) {
+        if (m_large) return m_large->for_each(fn);
+        for (size_t i = 0; i < m_count; i++)
+            fn(static_cast<const key_type &>(m_slots[i].key), m_slots[i].val);
+    }
+
+    // immutable methods:
+
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        if (m_large) return std::as_const(*m_large).for_each(fn);
+        for (size_t i = 0; i < m_count; i++) fn(m_slots[i].key, m_slots[i].val);
+    }
+
+    size_t capacity(void) const { return m_large ? m_large->capacity() : N; }
+
+    template <typename Q = key_type>
+    bool contains(const key_arg<Q> &key) {
+        return this->template get<Q>(key).has_value();
+    }
+
+    bool is_empty(void) const { return size() == 0; }
+
+    size_t size(void) const { return m_large ? m_large->size() : m_count; }
+
+    // Whether the entries still live in the object rather than on the heap
+    bool is_inline(void) const { return !m_large; }
+
+    MemoryUsage memory_usage(void) const {
+        MemoryUsage usage;
+        if (m_large) usage = m_large->memory_usage();
+        usage.object = sizeof(*this);  // `m_large` lives inside it
+        return usage;
+    }
+
+   private:
+    using Slot = typename Large::Slot;
+
+    // Tags padded to whole groups; the padding stays `ctrl_empty`
+    static constexpr size_t tag_bytes =
+        (N + ProbeGroup::width - 1) / ProbeGroup::width * ProbeGroup::width;
+
+    // Index of the inline entry holding `key`, or `N`
+    template <typename Q>
+    size_t find(const Q &key, uint64_t hash) const {
+        const int8_t h = ctrl_tag(hash);
+        for (size_t base = 0; base < m_count; base += ProbeGroup::width) {
+            for (auto m = ProbeGroup(&m_tags[base]).match(h); m;
+                 m.clear_lowest()) {
+                const size_t i = base + m.lowest();
+                if (m_slots[i].hash == hash && m_eq(m_slots[i].key, key))
+                    return i;
+            }
+        }
+        return N;
+    }
+
+    // Move the inline entries into a heap table, hashes and all
+    void spill(void) {
+        m_large.emplace(std::max(m_spill_capacity, 2 * N), m_hash, m_eq);
+        for (size_t i = 0; i < m_count; i++) {
+            Slot &slot = m_slots[i];
+            m_large->insert(std::move(slot.key), std::move(slot.val),
+                            slot.hash);
+            slot = Slot{};
+        }
+        std::fill(m_tags, m_tags + m_count, ctrl_empty);
+        m_count = 0;
+    }
+
+    Hash m_hash;
+    Eq m_eq;
+    size_t m_spill_capacity;
+    size_t m_count = 0;  // Inline entries, in `m_slots[0, m_count)`
+    int8_t m_tags[tag_bytes];  // `ctrl_tag` of each inline entry
+    Slot m_slots[N] = {};
+    std::optional<Large> m_large;  // Engaged once the entries spill over
+};
+
+// String keys to small values in 8-byte slots, for indexes too big to
+// spend 16 bytes per key on an `ArenaString` table's `std::string_view`: a
+// slot holds just a 32-bit `OffsetArena` handle to the key's bytes and the
+// value (`V` of up to 4 bytes keeps the slot at 8). It is a `HashTable`
+// over handles underneath, so it probes the same way, except that with no
+// cached hash a tag match goes straight to comparing keys through the arena,
+// and a resize rehashes every key from there. Other `Collision` policies
+// need the cached hash, and take 16-byte slots.
+//
+// A key takes its length and bytes rounded up to `Unit` bytes, and handles
+// address 2^32 units, so at most `2^32 / ceil((4 + key bytes) / Unit)` keys
+// fit: about 700M keys of 40 bytes or 270M of 120 at the default 8, and 1B
+// keys of up to 124 bytes at `Unit = 32`, for 16 bytes of padding per key
+// on average. Removed keys' bytes are reclaimed by rebuilding the table
+// over a compacted arena once they outweigh the live keys'.
+template <typename V = uint32_t, typename Hash = Fnv1aHash,
+          typename Reduce = ModuloReduce, typename Collision = GroupProbing,
+          size_t Unit = 8>
+struct PackedHashTable {
+    using Arena = OffsetArena<Unit>;
+
+    struct Handle {
+        uint32_t offset;
+    };
+
+    explicit PackedHashTable(size_t capacity, const Hash &hash = Hash())
+        : m_hash(hash),
+          m_arena(std::make_unique<Arena>()),
+          m_table(capacity, KeyHash{m_arena.get(), hash},
+                  KeyEq{m_arena.get()}) {}
+
+    // Like `HashTable`, a moved-from table is left empty, with an arena of
+    // its own for its functors to point at
+    PackedHashTable(PackedHashTable &&other)
+        : m_hash(other.m_hash),
+          m_arena(std::move(other.m_arena)),
+          m_table(std::move(other.m_table)),
+          m_key_bytes(other.m_key_bytes) {
+        other.reset();
+    }
+    PackedHashTable &operator=(PackedHashTable &&other) {
+        if (this == &other) return *this;
+        m_hash = other.m_hash;
+        m_arena = std::move(other.m_arena);
+        m_table = std::move(other.m_table);
+        m_key_bytes = other.m_key_bytes;
+        other.reset();
+        return *this;
+    }
+
+    // mutable methods:
+
+    void clear(void) {
+        m_table.clear();
+        m_arena->clear();
+        m_key_bytes = 0;
+    }
+
+    std::optional<V> get(std::string_view key) {
+        return m_table.template get<std::string_view>(key);
+    }
+
+    // Insert or update the value at `key`, probing once: the key is stored
+    // up front and dropped again if it was already there. Throws
+    // `std::length_error` if the live keys fill the arena.
+    void insert(std::string_view key, V val) {
+        const uint64_t hash = m_hash(key);
+        if (!m_arena->has_room(key.size()) && m_arena->used() > m_key_bytes)
+            compact();  // Make room from removed keys first
+        const Handle handle{m_arena->store(key)};
+        if (m_table.insert_or_assign(handle, std::move(val), hash))
+            m_key_bytes += Arena::footprint(key.size());
+        else
+            m_arena->drop_last();
+    }
+
+    bool remove(std::string_view key) {
+        if (!m_table.template remove<std::string_view>(key)) return false;
+        m_key_bytes -= Arena::footprint(key.size());
+        if (m_arena->used() - m_key_bytes > m_key_bytes + Arena::chunk_size)
+            compact();
+        return true;
+    }
+
+    void reserve(size_t n) { m_table.reserve(n); }
+
+    // Call `fn(key, val)` for every entry, as `HashTable::for_each` does
+    template <typename Fn>
+    void for_each(Fn &&fn) {
+        m_table.for_each([&](const Handle &key, V &val) {
+            fn(m_arena->load(key.offset), val);
+        });
+    }
+
+    // immutable methods:
+
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        m_table.for_each([&](const Handle &key, const V &val) {
+            fn(m_arena->load(key.offset), val);
+        });
+    }
+
+    size_t capacity(void) const { return m_table.capacity(); }
+
+    bool contains(std::string_view key) { return get(key).has_value(); }
+
+    bool is_empty(void) const { return m_table.is_empty(); }
+
+    size_t size(void) const { return m_table.size(); }
+
+    MemoryUsage memory_usage(void) const {
+        MemoryUsage usage = m_table.memory_usage();
+        usage.object = sizeof(*this) + sizeof(Arena);
+        usage.arena += m_arena->allocated();
+        return usage;
+    }
+
+   private:
+    // `Hash` and equality on handles resolved through the arena, and on
+    // plain `std::string_view`s for lookups
+    struct KeyHash {
+        using is_transparent = void;
+        // Resizes rehash keys through the arena rather than store hashes
+        static constexpr bool cache_hash =
+            !std::is_same_v<Collision, GroupProbing>;
+        const Arena *arena = nullptr;
+        Hash hash;
+
+        uint64_t operator()(std::string_view key) const { return hash(key); }
+        uint64_t operator()(Handle key) const {
+            return hash(arena->load(key.offset));
+        }
+    };
+    struct KeyEq {
+        using is_transparent = void;
+        const Arena *arena = nullptr;
+
+        bool operator()(Handle a, std::string_view b) const {
+            return arena->load(a.offset) == b;
+        }
+        // An insert compares its freshly stored key with the stored ones
+        bool operator()(Handle a, Handle b) const {
+            return arena->load(a.offset) == arena->load(b.offset);
+        }
+    };
+
+    using Table = HashTable<Handle, V, KeyHash, KeyEq, Reduce, Collision>;
+
+    // Empty the table after its storage moved out
+    void reset(void) {
+        m_arena = std::make_unique<Arena>();
+        m_table =
+            Table(0, KeyHash{m_arena.get(), m_hash}, KeyEq{m_arena.get()});
+        m_key_bytes = 0;
+    }
+
+    // Rehash the live entries into a table of the same capacity over a
+    // fresh arena holding only their keys. Both copies exist meanwhile.
+    void compact(void) {
+        auto arena = std::make_unique<Arena>();
+        Table table(m_table.capacity(), KeyHash{arena.get(), m_hash},
+                    KeyEq{arena.get()});
+        m_table.for_each([&](const Handle &key, V &val) {
+            const std::string_view bytes = m_arena->load(key.offset);
+            table.insert(Handle{arena->store(bytes)}, std::move(val),
+                         m_hash(bytes));
+        });
+        m_table = std::move(table);
+        m_arena = std::move(arena);
+    }
+
+    Hash m_hash;
+    // On the heap, so the functors' pointers survive moving the table
+    std::unique_ptr<Arena> m_arena;
+    Table m_table;
+    uint64_t m_key_bytes = 0;  // Arena bytes held by live entries
+};
+
+// Eight control bytes read as one relaxed atomic word and matched with SWAR
+// bit tricks, for tables whose readers probe without taking a lock.
+struct WordGroup {
+    static constexpr size_t width = 8;
+    static constexpr uint64_t lsbs = 0x0101010101010101ull;
+    static constexpr uint64_t msbs = 0x8080808080808080ull;
+    static constexpr uint64_t all_empty = msbs;  // 8 x `ctrl_empty`
+    using Mask = BitMask<uint64_t, width, 3>;
+
+    uint64_t ctrl;
+
+    // May also flag a byte right above a true match; callers compare full
+    // hashes anyway
+    Mask match(int8_t tag) const {
+        const uint64_t x = ctrl ^ (lsbs * static_cast<uint8_t>(tag));
+        return Mask{(x - lsbs) & ~x & msbs};
+    }
+    Mask match_empty(void) const { return Mask{ctrl & ~(ctrl << 6) & msbs}; }
+    Mask match_free(void) const { return Mask{ctrl & msbs}; }
+
+    static uint64_t with_byte(uint64_t word, size_t i, int8_t c) {
+        const size_t shift = i * 8;
+        return (word & ~(uint64_t{0xff} << shift)) |
+               (uint64_t{static_cast<uint8_t>(c)} << shift);
+    }
+};
+
+// Trivially copyable `T` stored as relaxed atomic words, so a seqlock reader
+// may copy it while a writer changes it without a data race. The copy is
+// only trusted once the reader's sequence check passes.
+template <typename T>
+struct AtomicCell {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static constexpr size_t words = (sizeof(T) + 7) / 8;
+
+    std::atomic<uint64_t> bits[words];
+
+    T load(void) const {
+        uint64_t buf[words];
+        for (size_t i = 0; i < words; i++)
+            buf[i] = bits[i].load(std::memory_order_relaxed);
+        T out;
+        std::memcpy(&out, buf, sizeof(T));
+        return out;
+    }
+    void store(const T &val) {
+        uint64_t buf[words] = {};
+        std::memcpy(buf, &val, sizeof(T));
+        for (size_t i = 0; i < words; i++)
+            bits[i].store(buf[i], std::memory_order_relaxed);
+    }
+};
+
+// Epoch-based reclamation for memory `ConcurrentHashTable` unpublishes.
+// Each reading thread claims a slot of its own, on its own cache line, and
+// a read publishes there the epoch it started in, so readers write no
+// shared memory. A writer about to free memory bumps the epoch and waits
+// until every slot is idle or has moved past it. Slots are shared by all
+// tables, handed back when their thread exits and never freed.
+struct ReaderEpochs {
+    // Marks the calling thread as reading while it lives; not reentrant
+    struct Guard {
+        Guard(void) : m_epoch(local()) {
+            m_epoch.store(registry().epoch.load(std::memory_order_seq_cst),
+                          std::memory_order_seq_cst);
+        }
+        ~Guard() { m_epoch.store(idle, std::memory_order_release); }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+       private:
+        std::atomic<uint64_t> &m_epoch;
+    };
+
+    // Wait for every read that may have started before the call to end.
+    // Call after unpublishing with seq_cst stores, and not while reading.
+    static void synchronize(void) {
+        const uint64_t epoch =
+            registry().epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        for (Slot *slot = registry().head.load(std::memory_order_acquire);
+             slot != nullptr; slot = slot->next) {
+            while (true) {
+                const uint64_t e = slot->epoch.load(std::memory_order_seq_cst);
+                if (e == idle || e >= epoch) break;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+   private:
+    static constexpr uint64_t idle = 0;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{idle};
+        std::atomic<bool> taken{true};
+        Slot *next = nullptr;
+    };
+
+    struct Registry {
+        alignas(64) std::atomic<uint64_t> epoch{idle + 1};
+        alignas(64) std::atomic<Slot *> head{nullptr};
+    };
+
+    // A thread's claim on a slot: the first free one, or a new one pushed
+    // onto the list
+    struct Owner {
+        Owner(void) {
+            Registry &reg = registry();
+            for (slot = reg.head.load(std::memory_order_acquire);
+                 slot != nullptr; slot = slot->next) {
+                bool expected = false;
+                if (slot->taken.compare_exchange_strong(
+                        expected, true, std::memory_order_acquire))
+                    return;
+            }
+            slot = new Slot;
+            slot->next = reg.head.load(std::memory_order_relaxed);
+            while (!reg.head.compare_exchange_weak(slot->next, slot,
+                                                   std::memory_order_release))
+                ;
+        }
+        ~Owner() { slot->taken.store(false, std::memory_order_release); }
+
+        Slot *slot;
+    };
+
+    static Registry &registry(void) {
+        static Registry reg;
+        return reg;
+    }
+    static std::atomic<uint64_t> &local(void) {
+        thread_local Owner owner;
+        return owner.slot->epoch;
+    }
+};
+
+// Thread-safe variant of `HashTable` for read-mostly workloads. Keys are
+// split by hash into `segment_count` segments, each an open-addressing table
+// with its own mutex for writers and a sequence counter for readers: `get`
+// never waits on a lock and, outside a migration, writes only its thread's
+// `ReaderEpochs` slot; it probes optimistically and retries if a writer
+// touched the segment meanwhile. Keys and values must be trivially copyable
+// (use `ArenaString` for string keys the table owns, or `std::string_view`
+// into memory that outlives the table).
+//
+// A full segment migrates to a new array cooperatively: the writer that
+// finds it full only allocates and publishes the new array, then every later
+// write to the segment, and every `get` that finds its lock free, moves
+// `migrate_step` groups across. Until the old array is empty, lookups probe
+// the new one and then the old one, so nobody waits for a whole rebuild. The
+// writer that empties the old array frees it once reads that started before
+// have ended, so a segment holds at most two arrays; arena key bytes are
+// kept until destruction.
+template <typename K, typename V, typename Hash = Fnv1aHash,
+          typename Eq = std::equal_to<>>
+struct ConcurrentHashTable {
+    static constexpr double load_capacity_threshold = 0.7;
+    static constexpr size_t default_segment_count = 64;
+    // Groups of old array moved per helping call while a segment migrates
+    static constexpr size_t migrate_step = 4;
+
+    using key_type = typename KeyStorage<K>::type;
+
+    template <typename Q>
+    using key_arg = typename KeyArg<is_transparent<Hash>::value &&
+                                    is_transparent<Eq>::value>::
+        template type<Q, key_type>;
+
+    static_assert(std::is_trivially_copyable_v<key_type> &&
+                      std::is_trivially_copyable_v<V>,
+                  "seqlock readers copy slots while writers change them");
+
+    // `capacity` is spread over `segments`, rounded up to a power of two
+    explicit ConcurrentHashTable(size_t capacity,
+                                 size_t segments = default_segment_count,
+                                 const Hash &hash = Hash(), const Eq &eq = Eq())
+        : m_hash(hash), m_eq(eq) {
+        while ((size_t{1} << m_segment_bits) < segments) m_segment_bits += 1;
+        m_segments = std::make_unique<Segment[]>(segment_count());
+        const size_t per_segment = capacity / segment_count() + 1;
+        for (size_t i = 0; i < segment_count(); i++) {
+            Segment &seg = m_segments[i];
+            seg.arrays.push_back(std::make_unique<Array>(per_segment));
+            seg.current.store(seg.arrays.back().get(),
+                              std::memory_order_relaxed);
+        }
+    }
+
+    // mutable methods:
+
+    // Remove every entry. Safe alongside readers; arena key bytes stay
+    // allocated until destruction.
+    void clear(void) {
+        for (size_t i = 0; i < segment_count(); i++) {
+            Segment &seg = m_segments[i];
+            std::lock_guard<std::mutex> guard(seg.lock);
+            Array &arr = *seg.current.load(std::memory_order_relaxed);
+            seg.begin_write();
+            const bool migrating =
+                seg.old.load(std::memory_order_relaxed) != nullptr;
+            seg.old.store(nullptr, std::memory_order_seq_cst);  // Abandon it
+            for (size_t g = 0; g < arr.groups; g++)
+                arr.ctrl[g].store(WordGroup::all_empty,
+                                  std::memory_order_relaxed);
+            seg.end_write();
+            seg.size.store(0, std::memory_order_relaxed);
+            seg.tombstones = 0;
+            seg.migrated = 0;
+            if (migrating) retire(seg);
+        }
+    }
+
+    // Insert or update the value at `key`
+    void insert(key_type key, V val) {
+        const uint64_t hash = m_hash(key);
+        Segment &seg = segment_for(hash);
+        std::lock_guard<std::mutex> guard(seg.lock);
+        migrate(seg);
+        Array *arr = seg.current.load(std::memory_order_relaxed);
+        Cell *cell = locked_find(*arr, key, hash);
+        if (Array *old = seg.old.load(std::memory_order_relaxed); !cell && old)
+            cell = locked_find(*old, key, hash);  // Not migrated yet
+        if (cell != nullptr) {
+            seg.begin_write();
+            cell->val.store(val);  // Update success
+            seg.end_write();
+            return;
+        }
+        const size_t used = seg.size.load(std::memory_order_relaxed) +
+                            seg.tombstones + 1;
+        if (static_cast<double>(used) / arr->capacity() >
+            load_capacity_threshold)
+            arr = grow(seg);
+        if constexpr (KeyStorage<K>::owns_bytes) key = seg.arena.store(key);
+        seg.begin_write();
+        if (arr->place(hash, key, val)) seg.tombstones -= 1;
+        seg.end_write();
+        seg.size.fetch_add(1, std::memory_order_relaxed);  // Insert success
+    }
+
+    // Remove the entry at `key`, returning whether it was present
+    template <typename Q = key_type>
+    bool remove(const key_arg<Q> &key) {
+        const uint64_t hash = m_hash(key);
+        Segment &seg = segment_for(hash);
+        std::lock_guard<std::mutex> guard(seg.lock);
+        migrate(seg);
+        Array *arr = seg.current.load(std::memory_order_relaxed);
+        Cell *cell = locked_find(*arr, key, hash);
+        if (Array *old = seg.old.load(std::memory_order_relaxed);
+            !cell && old) {
+            arr = old;  // Not migrated yet
+            cell = locked_find(*arr, key, hash);
+        }
+        if (cell == nullptr) return false;
+        const size_t index = static_cast<size_t>(cell - arr->cells.get());
+        const size_t g = index / WordGroup::width;
+        // A group that still has an empty slot was never passed over by a
+        // probe, so the slot can go straight back to empty
+        const WordGroup group{arr->ctrl[g].load(std::memory_order_relaxed)};
+        const int8_t c = group.match_empty() ? ctrl_empty : ctrl_deleted;
+        seg.begin_write();
+        arr->ctrl[g].store(
+            WordGroup::with_byte(group.ctrl, index % WordGroup::width, c),
+            std::memory_order_relaxed);
+        seg.end_write();
+        // Only the current array's tombstones count toward its load
+        if (c == ctrl_deleted &&
+            arr == seg.current.load(std::memory_order_relaxed))
+            seg.tombstones += 1;
+        seg.size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // immutable methods:
+
+    // Retrieve the entry value at `key` without waiting on a lock. During a
+    // migration, also moves a step of it if no writer holds the segment.
+    template <typename Q = key_type>
+    std::optional<V> get(const key_arg<Q> &key) const {
+        const uint64_t hash = m_hash(key);
+        Segment &seg = segment_for(hash);
+        if (seg.old.load(std::memory_order_relaxed) != nullptr &&
+            seg.lock.try_lock()) {
+            migrate(seg);
+            seg.lock.unlock();
+        }
+        // Reading until done with the arrays, so `retire` cannot free one
+        // this call still probes
+        const ReaderEpochs::Guard reading;
+        std::optional<V> result;
+        while (true) {
+            const uint64_t seq = seg.seq.load(std::memory_order_acquire);
+            if (seq & 1) {  // A writer is mid-update
+                std::this_thread::yield();
+                continue;
+            }
+            const Array &arr = *seg.current.load(std::memory_order_seq_cst);
+            const Array *old = seg.old.load(std::memory_order_seq_cst);
+            bool torn = false;
+            result = read(arr, seg, seq, key, hash, torn);
+            if (!result && !torn && old != nullptr)
+                result = read(*old, seg, seq, key, hash, torn);
+            if (!torn && seg.unchanged_since(seq)) break;  // Else retry
+        }
+        return result;
+    }
+
+    // Check for the existence of a key without retrieving its value
+    template <typename Q = key_type>
+    bool contains(const key_arg<Q> &key) const {
+        return this->template get<Q>(key).has_value();
+    }
+
+    // Slots across the live arrays, taking the segment locks one at a time
+    // since `retire` may free an array being read
+    size_t capacity(void) const {
+        size_t cap = 0;
+        for (size_t i = 0; i < segment_count(); i++) {
+            Segment &seg = m_segments[i];
+            std::lock_guard<std::mutex> guard(seg.lock);
+            cap += seg.current.load(std::memory_order_relaxed)->capacity();
+        }
+        return cap;
+    }
+
+    // Check if the hash table is empty
+    bool is_empty(void) const { return size() == 0; }
+
+    // Return count of entries in hash table, exact once writers are quiet
+    size_t size(void) const {
+        size_t count = 0;
+        for (size_t i = 0; i < segment_count(); i++)
+            count += m_segments[i].size.load(std::memory_order_relaxed);
+        return count;
+    }
+
+    size_t segment_count(void) const { return size_t{1} << m_segment_bits; }
+
+    // Bytes allocated for each segment's arrays (two while one migrates)
+    // and key arena, taking the segment locks one at a time
+    MemoryUsage memory_usage(void) const {
+        MemoryUsage usage;
+        usage.object = sizeof(*this) + segment_count() * sizeof(Segment);
+        for (size_t i = 0; i < segment_count(); i++) {
+            Segment &seg = m_segments[i];
+            std::lock_guard<std::mutex> guard(seg.lock);
+            for (const auto &arr : seg.arrays) {
+                usage.ctrl += arr->groups * sizeof(std::atomic<uint64_t>);
+                usage.slots += arr->capacity() * sizeof(Cell);
+            }
+            usage.arena += seg.arena.allocated();
+        }
+        return usage;
+    }
+
+   private:
+    // data structures:
+
+    struct Cell {
+        std::atomic<uint64_t> hash;
+        AtomicCell<key_type> key;
+        AtomicCell<V> val;
+    };
+
+    // One segment's slots, in aligned groups of `WordGroup::width` so each
+    // group's control bytes are one atomic word.
+    struct Array {
+        size_t groups;  // Power of two
+        std::unique_ptr<std::atomic<uint64_t>[]> ctrl;
+        std::unique_ptr<Cell[]> cells;
+
+        explicit Array(size_t min_capacity) : groups(1) {
+            while (capacity() < min_capacity) groups <<= 1;
+            ctrl = std::make_unique<std::atomic<uint64_t>[]>(groups);
+            for (size_t g = 0; g < groups; g++)
+                ctrl[g].store(WordGroup::all_empty, std::memory_order_relaxed);
+            cells = std::make_unique<Cell[]>(capacity());
+        }
+
+        size_t capacity(void) const { return groups * WordGroup::width; }
+
+        // Call `fn(cell)` for each full slot on the probe sequence for
+        // `hash` whose full hash matches, until it returns true or a group
+        // with an empty slot ends the sequence.
+        template <typename Fn>
+        void probe(uint64_t hash, Fn &&fn) const {
+            const int8_t h = ctrl_tag(hash);
+            size_t g = hash & (groups - 1);
+            for (size_t seen = 0; seen < groups; seen++) {
+                const WordGroup group{ctrl[g].load(std::memory_order_relaxed)};
+                for (auto match = group.match(h); match; match.clear_lowest()) {
+                    const Cell &cell =
+                        cells[g * WordGroup::width + match.lowest()];
+                    if (cell.hash.load(std::memory_order_relaxed) != hash)
+                        continue;
+                    if (fn(cell)) return;
+                }
+                if (group.match_empty()) return;  // Key not found
+                g = (g + 1) & (groups - 1);       // Next group
+            }
+        }
+
+        // Store a new entry in the first free slot for `hash`, returning
+        // whether it reused a tombstone. Caller holds the segment lock.
+        bool place(uint64_t hash, const key_type &key, const V &val) {
+            size_t g = hash & (groups - 1);
+            while (true) {
+                const uint64_t word = ctrl[g].load(std::memory_order_relaxed);
+                auto free = WordGroup{word}.match_free();
+                if (free) {
+                    const size_t i = free.lowest();
+                    const bool reused =
+                        static_cast<int8_t>(word >> (i * 8)) == ctrl_deleted;
+                    Cell &cell = cells[g * WordGroup::width + i];
+                    cell.hash.store(hash, std::memory_order_relaxed);
+                    cell.key.store(key);
+                    cell.val.store(val);
+                    ctrl[g].store(WordGroup::with_byte(word, i, ctrl_tag(hash)),
+                                  std::memory_order_relaxed);
+                    return reused;
+                }
+                g = (g + 1) & (groups - 1);  // Next group
+            }
+        }
+    };
+
+    // The sequence counter is odd while a writer is changing the segment;
+    // it covers both arrays during a migration.
+    struct alignas(64) Segment {
+        std::mutex lock;
+        std::atomic<uint64_t> seq{0};
+        std::atomic<Array *> current{nullptr};
+        std::atomic<Array *> old{nullptr};  // Still migrating, or null
+        std::atomic<size_t> size{0};  // Entries across both arrays
+        size_t tombstones = 0;  // In `current`; guarded by `lock`
+        size_t migrated = 0;    // Groups of `old` moved; guarded by `lock`
+        std::vector<std::unique_ptr<Array>> arrays;  // Live one is last
+        StringArena arena;  // Key bytes, used only for `ArenaString` keys
+
+        void begin_write(void) {
+            seq.store(seq.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        void end_write(void) {
+            seq.store(seq.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+        }
+        bool unchanged_since(uint64_t start) const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return seq.load(std::memory_order_relaxed) == start;
+        }
+    };
+
+    Segment &segment_for(uint64_t hash) const {
+        return m_segments[hash_partition(hash, m_segment_bits)];
+    }
+
+    // One seqlock read attempt of `key` in `arr` for `get`; sets `torn`
+    // instead if a writer got in since `seq`
+    template <typename Q>
+    std::optional<V> read(const Array &arr, const Segment &seg, uint64_t seq,
+                          const Q &key, uint64_t hash, bool &torn) const {
+        std::optional<V> result;
+        arr.probe(hash, [&](const Cell &cell) {
+            const key_type stored = cell.key.load();
+            const V val = cell.val.load();
+            // Only dereference `stored` once it is known to be a
+            // consistent snapshot
+            if (!seg.unchanged_since(seq)) {
+                torn = true;
+                return true;
+            }
+            if (!m_eq(stored, key)) return false;
+            result = val;
+            return true;
+        });
+        return result;
+    }
+
+    // Writer-side lookup, caller holds the segment lock
+    template <typename Q>
+    Cell *locked_find(const Array &arr, const Q &key, uint64_t hash) const {
+        const Cell *found = nullptr;
+        arr.probe(hash, [&](const Cell &cell) {
+            if (!m_eq(cell.key.load(), key)) return false;
+            found = &cell;
+            return true;
+        });
+        return const_cast<Cell *>(found);
+    }
+
+    // Start migrating the segment to a fresh array (doubled unless
+    // tombstones filled it): publish it as current, with the old array still
+    // probed until `migrate` has emptied it. Finishes any migration still in
+    // flight first. Caller holds the segment lock.
+    Array *grow(Segment &seg) {
+        while (seg.old.load(std::memory_order_relaxed) != nullptr) migrate(seg);
+        Array *prev = seg.current.load(std::memory_order_relaxed);
+        const size_t live = seg.size.load(std::memory_order_relaxed);
+        const bool crowded = static_cast<double>(live) / prev->capacity() >
+                             load_capacity_threshold / 2;
+        auto fresh =
+            std::make_unique<Array>(prev->capacity() * (crowded ? 2 : 1));
+        Array *published = fresh.get();
+        seg.arrays.push_back(std::move(fresh));
+        seg.begin_write();
+        seg.old.store(prev, std::memory_order_relaxed);
+        seg.current.store(published, std::memory_order_release);
+        seg.end_write();
+        seg.tombstones = 0;
+        seg.migrated = 0;
+        return published;
+    }
+
+    // Move the next `migrate_step` groups of the segment's old array into
+    // the current one, and retire the old array once all have moved. Moved
+    // slots become tombstones, so probes through them still reach entries
+    // not moved yet. Caller holds the segment lock.
+    void migrate(Segment &seg) const {
+        Array *old = seg.old.load(std::memory_order_relaxed);
+        if (old == nullptr) return;
+        Array &arr = *seg.current.load(std::memory_order_relaxed);
+        const size_t end = std::min(seg.migrated + migrate_step, old->groups);
+        seg.begin_write();
+        for (; seg.migrated < end; seg.migrated++) {
+            const size_t g = seg.migrated;
+            uint64_t word = old->ctrl[g].load(std::memory_order_relaxed);
+            for (size_t i = 0; i < WordGroup::width; i++) {
+                if (static_cast<int8_t>(word >> (i * 8)) < 0)
+                    continue;  // Empty or tombstone
+                const Cell &cell = old->cells[g * WordGroup::width + i];
+                if (arr.place(cell.hash.load(std::memory_order_relaxed),
+                              cell.key.load(), cell.val.load()))
+                    seg.tombstones -= 1;
+                word = WordGroup::with_byte(word, i, ctrl_deleted);
+            }
+            old->ctrl[g].store(word, std::memory_order_relaxed);
+        }
+        const bool done = seg.migrated == old->groups;
+        if (done) {
+            seg.old.store(nullptr, std::memory_order_seq_cst);
+            seg.migrated = 0;
+        }
+        seg.end_write();
+        if (done) retire(seg);
+    }
+
+    // Free the arrays the segment no longer publishes, once the reads that
+    // could still hold one have ended; later reads only see the live array.
+    // Caller holds the segment lock and has unpublished the arrays with
+    // seq_cst stores.
+    static void retire(Segment &seg) {
+        ReaderEpochs::synchronize();
+        Array *live = seg.current.load(std::memory_order_relaxed);
+        auto &arrays = seg.arrays;
+        arrays.erase(std::remove_if(arrays.begin(), arrays.end(),
+                                    [&](const std::unique_ptr<Array> &arr) {
+                                        return arr.get() != live;
+                                    }),
+                     arrays.end());
+    }
+
+    // members:
+
+    Hash m_hash;
+    Eq m_eq;
+    unsigned m_segment_bits = 0;
+    std::unique_ptr<Segment[]> m_segments;
+};
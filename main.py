@@ -5,7 +5,7 @@ from copy import copy
 from enum import Enum
 from functools import lru_cache
 from itertools import cycle
-from sys import exit
+from sys import argv, exit
 
 from faker import Faker
 
@@ -317,6 +317,12 @@ def gen_fake_data(fake: Faker, count: int) -> list[HashTable.Entry]:
     return [HashTable.Entry(key=k, val=v) for k, v in zip(keys, vals)]
 
 
+def dump_keys(path: str, entries: list[HashTable.Entry]) -> None:
+    """Write one key per line, in insertion order, for `bench --trace=PATH`"""
+    with open(path, 'w', encoding='utf-8') as f:
+        f.writelines(f'{e.m_key}\n' for e in entries)
+
+
 def main() -> int:
     ht_capacity = (HashTable.DEFAULT_CAPACITY ** 1)
     num_entries = (2 * (10 ** 4))
@@ -325,6 +331,8 @@ def main() -> int:
     ht = HashTable(capacity=ht_capacity, hash_fn=HTHashFn.FnType.sha256)
 
     fake_entries: list[HashTable.Entry] = gen_fake_data(fake, num_entries)
+    if len(argv) == 3 and argv[1] == '--dump-keys':
+        dump_keys(argv[2], fake_entries)
     ht_entries: cycle[HashTable.Entry] = cycle(fake_entries)
 
     for _ in range(num_entries):
@@ -0,0 +1,200 @@
+// stress.cpp
+//
+// Threaded check of `ConcurrentHashTable`: writers insert, update and remove
+// keys while readers `get` them, across many segment migrations, and every
+// value read and the final contents are checked. Best run under TSan too:
+//
+//   g++ -std=c++17 -O2 -pthread stress.cpp -o stress
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -pthread stress.cpp -o stress
+//   ./stress --writers=4 --readers=4 --keys=50000 --segments=4
+//
+// Each writer owns the keys "w<writer>-<i>": it inserts them all, updates
+// every seventh and removes every third, so a table grown from a few slots
+// per segment migrates many times meanwhile. It also rewrites the "stable-"
+// keys, inserted up front and never removed, with their unchanged values.
+// A churn phase then inserts and removes keys at a steady size, which only
+// rebuilds arrays in place, to exercise freeing the retired ones under
+// readers. Readers must always find every stable key, and any value they
+// read for any key must be that key's, with both halves intact (values are
+// two words, so a torn copy shows), and now and then they read `capacity()`
+// alongside the migrations. Exits 1 on the first failure.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "hash_table.hpp"
+
+struct Config {
+    size_t writers = 4;
+    size_t readers = 4;
+    size_t keys = 50000;  // Per writer
+    size_t stable = 1000;
+    size_t churn = 200000;  // Insert-remove pairs per writer
+    size_t segments = 4;
+};
+
+// Two words that must match, so a reader that copied half of an update sees
+// the tear
+struct Value {
+    uint64_t id;
+    uint64_t check;
+};
+
+using Table = ConcurrentHashTable<ArenaString, Value, WyHash>;
+
+Value value_for(std::string_view key) {
+    const uint64_t id = WyHash()(key);
+    return {id, ~id};
+}
+
+std::string writer_key(size_t writer, size_t i) {
+    return "w" + std::to_string(writer) + "-" + std::to_string(i);
+}
+
+std::string stable_key(size_t i) { return "stable-" + std::to_string(i); }
+
+std::atomic<bool> failed{false};
+
+void fail(const char *what, std::string_view key) {
+    if (!failed.exchange(true))
+        std::fprintf(stderr, "FAIL %s: %.*s\n", what,
+                     static_cast<int>(key.size()), key.data());
+}
+
+void check_value(const std::optional<Value> &val, std::string_view key) {
+    if (!val) return;
+    if (val->check != ~val->id) fail("torn value", key);
+    if (val->id != value_for(key).id) fail("wrong value", key);
+}
+
+void write(Table &table, const Config &cfg, size_t w) {
+    for (size_t i = 0; i < cfg.keys && !failed; i++) {
+        const std::string key = writer_key(w, i);
+        table.insert(key, value_for(key));
+        if (i % 7 == 0) table.insert(key, value_for(key));  // Update
+        if (i % 3 == 0 && !table.remove(key)) fail("remove missed", key);
+        const std::string stable = stable_key(i % cfg.stable);
+        table.insert(stable, value_for(stable));
+    }
+}
+
+void churn(Table &table, const Config &cfg, size_t w) {
+    for (size_t i = 0; i < cfg.churn && !failed; i++) {
+        const std::string key = "c" + std::to_string(w) + "-" +
+                                std::to_string(i);
+        table.insert(key, value_for(key));
+        if (i >= 64) {  // Keep 64 live per writer
+            const std::string old = "c" + std::to_string(w) + "-" +
+                                    std::to_string(i - 64);
+            if (!table.remove(old)) fail("churn remove missed", old);
+        }
+    }
+}
+
+void read(const Table &table, const Config &cfg, size_t r,
+          const std::atomic<bool> &done) {
+    uint64_t state = r + 1;
+    while (!done && !failed) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const size_t i = static_cast<size_t>(state >> 33);
+        const std::string stable = stable_key(i % cfg.stable);
+        const auto found = table.get(stable);
+        if (!found) fail("stable key missing", stable);
+        check_value(found, stable);
+        const std::string key = writer_key(i % cfg.writers, i % cfg.keys);
+        check_value(table.get(key), key);
+        if (i % 4096 == 0 && table.capacity() == 0) fail("no capacity", "");
+    }
+}
+
+// Run `phase(w)` on every writer thread while the readers run
+template <typename Phase>
+void run_phase(const Table &table, const Config &cfg, Phase &&phase) {
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < cfg.readers; r++)
+        readers.emplace_back([&, r] { read(table, cfg, r, done); });
+    std::vector<std::thread> writers;
+    for (size_t w = 0; w < cfg.writers; w++) writers.emplace_back(phase, w);
+    for (auto &writer : writers) writer.join();
+    done = true;
+    for (auto &reader : readers) reader.join();
+}
+
+Config parse_args(int argc, char **argv) {
+    Config cfg;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const auto value = [&](std::string_view flag) -> const char * {
+            if (arg.substr(0, flag.size()) != flag) return nullptr;
+            return argv[i] + flag.size();
+        };
+        if (const char *v = value("--writers=")) {
+            cfg.writers = std::strtoull(v, nullptr, 10);
+        } else if (const char *v = value("--readers=")) {
+            cfg.readers = std::strtoull(v, nullptr, 10);
+        } else if (const char *v = value("--keys=")) {
+            cfg.keys = std::strtoull(v, nullptr, 10);
+        } else if (const char *v = value("--churn=")) {
+            cfg.churn = std::strtoull(v, nullptr, 10);
+        } else if (const char *v = value("--segments=")) {
+            cfg.segments = std::strtoull(v, nullptr, 10);
+        } else {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            std::exit(1);
+        }
+    }
+    if (cfg.writers == 0 || cfg.keys == 0) {
+        std::fprintf(stderr, "--writers and --keys must be positive\n");
+        std::exit(1);
+    }
+    return cfg;
+}
+
+int main(int argc, char **argv) {
+    const Config cfg = parse_args(argc, argv);
+    // A few slots per segment, so the inserts migrate every segment often
+    Table table(16, cfg.segments);
+    for (size_t i = 0; i < cfg.stable; i++) {
+        const std::string key = stable_key(i);
+        table.insert(key, value_for(key));
+    }
+
+    run_phase(table, cfg, [&](size_t w) { write(table, cfg, w); });
+    const size_t grown = table.capacity();
+    run_phase(table, cfg, [&](size_t w) { churn(table, cfg, w); });
+    if (failed) return 1;
+
+    // Exact contents once the writers are done
+    size_t expect = cfg.stable + cfg.writers * std::min<size_t>(cfg.churn, 64);
+    for (size_t i = 0; i < cfg.stable; i++) {
+        const std::string key = stable_key(i);
+        const auto found = table.get(key);
+        if (!found) fail("stable key lost", key);
+        check_value(found, key);
+    }
+    for (size_t w = 0; w < cfg.writers; w++) {
+        for (size_t i = 0; i < cfg.keys; i++) {
+            const std::string key = writer_key(w, i);
+            const auto found = table.get(key);
+            if (found.has_value() == (i % 3 == 0))
+                fail(found ? "removed key present" : "key lost", key);
+            check_value(found, key);
+            expect += i % 3 != 0;
+        }
+    }
+    if (table.size() != expect) fail("size mismatch", "");
+    if (failed) return 1;
+    std::printf("ok: %zu entries, capacity %zu after inserts, %zu after "
+                "churn, %zu bytes\n",
+                table.size(), grown, table.capacity(),
+                table.memory_usage().total());
+    return 0;
+}
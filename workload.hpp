@@ -0,0 +1,128 @@
+// workload.hpp
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Zipfian ranks over `[0, n)` with skew `theta` in `(0, 1)`, using the
+// constant-time method of Gray et al. ("Quickly Generating Billion-Record
+// Synthetic Databases"), as YCSB does. Rank 0 is the hottest. Construction
+// sums `n` terms once.
+struct ZipfDistribution {
+    ZipfDistribution(uint64_t n, double theta)
+        : m_n(n), m_theta(theta), m_alpha(1.0 / (1.0 - theta)) {
+        for (uint64_t i = 1; i <= n; i++) m_zetan += 1.0 / std::pow(i, theta);
+        const double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        m_eta =
+            (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / m_zetan);
+    }
+
+    template <typename Rng>
+    uint64_t operator()(Rng &rng) {
+        const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        const double uz = u * m_zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, m_theta)) return 1;
+        const auto rank = static_cast<uint64_t>(
+            m_n * std::pow(m_eta * u - m_eta + 1.0, m_alpha));
+        return rank < m_n ? rank : m_n - 1;
+    }
+
+   private:
+    uint64_t m_n;
+    double m_theta;
+    double m_alpha;
+    double m_zetan = 0;
+    double m_eta = 0;
+};
+
+// Which keys a workload touches and how often. Parsed from a spec:
+//   "uniform"           every key equally likely
+//   "zipf:THETA"        Zipfian with skew THETA, hot keys scattered
+//   "hotspot:KEYS:OPS"  a KEYS share of the keys gets an OPS share of ops
+struct KeyDistribution {
+    enum class Kind { uniform, zipf, hotspot };
+
+    Kind kind = Kind::uniform;
+    double a = 0;  // Zipf theta, or hotspot key share
+    double b = 0;  // Hotspot op share
+
+    // Returns false, leaving `*this` untouched, on a malformed spec
+    bool parse(std::string_view spec) {
+        const std::string str(spec);
+        KeyDistribution d;
+        char *end = nullptr;
+        if (spec == "uniform") {
+            d.kind = Kind::uniform;
+        } else if (spec.substr(0, 5) == "zipf:") {
+            d.kind = Kind::zipf;
+            d.a = std::strtod(str.c_str() + 5, &end);
+            if (*end != '\0' || d.a <= 0 || d.a >= 1) return false;
+        } else if (spec.substr(0, 8) == "hotspot:") {
+            d.kind = Kind::hotspot;
+            d.a = std::strtod(str.c_str() + 8, &end);
+            if (*end != ':') return false;
+            d.b = std::strtod(end + 1, &end);
+            if (*end != '\0' || d.a <= 0 || d.a > 1 || d.b < 0 || d.b > 1)
+                return false;
+        } else {
+            return false;
+        }
+        *this = d;
+        return true;
+    }
+
+    // `count` key indices in `[0, n)` drawn from this distribution
+    std::vector<uint32_t> sample(size_t n, size_t count, uint64_t seed) const {
+        std::mt19937_64 rng(seed);
+        std::vector<uint32_t> out(count);
+        switch (kind) {
+            case Kind::uniform: {
+                std::uniform_int_distribution<uint64_t> pick(0, n - 1);
+                for (auto &i : out) i = static_cast<uint32_t>(pick(rng));
+                break;
+            }
+            case Kind::zipf: {
+                // Scatter ranks like YCSB's scrambled Zipfian, so hot keys
+                // aren't just the first ones inserted
+                ZipfDistribution zipf(n, a);
+                for (auto &i : out)
+                    i = static_cast<uint32_t>(
+                        (zipf(rng) * 0x9e3779b97f4a7c15ull) % n);
+                break;
+            }
+            case Kind::hotspot: {
+                const auto hot =
+                    std::max<uint64_t>(1, static_cast<uint64_t>(a * n));
+                std::uniform_real_distribution<double> coin(0, 1);
+                std::uniform_int_distribution<uint64_t> pick_hot(0, hot - 1);
+                std::uniform_int_distribution<uint64_t> pick_any(0, n - 1);
+                for (auto &i : out)
+                    i = static_cast<uint32_t>(coin(rng) < b ? pick_hot(rng)
+                                                            : pick_any(rng));
+                break;
+            }
+        }
+        return out;
+    }
+};
+
+// Keys dumped one per line by `main.py --dump-keys PATH`, in the order the
+// Python driver inserted them (duplicates included)
+inline std::vector<std::string> load_trace(const std::string &path) {
+    std::vector<std::string> keys;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        keys.push_back(std::move(line));
+    }
+    return keys;
+}